@@ -0,0 +1,668 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <new>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "parsing.hpp"
+
+
+
+// Every allocation in the process goes through here so a parse can be charged for its own
+std::atomic<std::size_t> allocation_count {0};
+
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  auto alignment = static_cast<std::size_t>(align);
+  if (void* ptr = std::aligned_alloc(alignment, (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+
+struct Sample {
+  std::size_t options = 0;
+  std::size_t groups = 0;
+  std::size_t tokens = 0;
+  double construct_ns = 0;
+  double compile_ns = 0;
+  double help_ns = 0;
+  // Copying the compiled parser, and then adding one option to the copy
+  double clone_ns = 0;
+  double extend_ns = 0;
+  double parse_ns = 0;
+  double ns_per_token = 0;
+  double allocations_per_parse = 0;
+  // Heap allocations left when the same parse draws from a reused monotonic_buffer_resource
+  double pooled_allocations_per_parse = 0;
+  long peak_rss_kb = 0;
+};
+
+struct ProcessSample {
+  double baseline_us = 0;
+  double linked_us = 0;
+};
+
+struct AbbrevSample {
+  std::size_t flags = 0;
+  double exact_ns = 0;
+  double abbrev_ns = 0;
+  double scan_ns = 0;
+};
+
+struct DefaultsSample {
+  std::size_t lines = 0;
+  double load_ns = 0;
+  double ns_per_line = 0;
+  double apply_ns = 0;
+  // The same defaults as a JSON object, one member per line
+  double json_load_ns = 0;
+  double json_ns_per_line = 0;
+};
+
+struct ImageSample {
+  std::size_t options = 0;
+  std::size_t bytes = 0;
+  double construct_ns = 0;
+  double load_ns = 0;
+  double compile_ns = 0;
+};
+
+struct StartupSample {
+  std::size_t subcommands = 0;
+  double lazy_ns = 0;
+  double register_ns_per_command = 0;
+  double eager_ns = 0;
+};
+
+auto make_parser(std::size_t options, std::size_t groups) -> parsing::ArgumentParser;
+auto make_argv(std::size_t options, std::size_t tokens) -> std::vector<std::string>;
+auto run(std::size_t options, std::size_t tokens, std::size_t iterations) -> Sample;
+auto run_startup(std::size_t subcommands, std::size_t iterations) -> StartupSample;
+auto run_processes(std::size_t runs) -> ProcessSample;
+auto run_abbrev(std::size_t flags, std::size_t iterations) -> AbbrevSample;
+auto run_defaults(std::size_t lines, std::size_t iterations) -> DefaultsSample;
+auto run_image(std::size_t options, std::size_t iterations) -> ImageSample;
+auto peak_rss_kb() -> long;
+auto scratch_file(const std::string& suffix) -> std::string;
+void write_json(std::ostream& out, const std::vector<Sample>& samples, const std::vector<StartupSample>& startup, const std::vector<AbbrevSample>& abbrev, const std::vector<DefaultsSample>& defaults, const std::vector<ImageSample>& images, const ProcessSample& process);
+
+
+int main(int argc, char** argv) {
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("parsing-bench");
+  parser.m.description = "Benchmarks parser construction, help rendering and parse_args over synthetic command lines.";
+  parser.add_argument("--max-options").type("uint").default_value("100000").help("Largest parser to generate (10 to 100000 options).");
+  parser.add_argument("--max-tokens").type("uint").default_value("1000000").help("Largest argv to generate.");
+  parser.add_argument("--max-subcommands").type("uint").default_value("300").help("Most subcommands to time startup with (10 to 10000).");
+  parser.add_argument("--max-flags").type("uint").default_value("10000").help("Most flags to time abbreviation lookups with (100 to 100000).");
+  parser.add_argument("--max-defaults").type("uint").default_value("10000").help("Most lines of defaults file to time loading (100 to 100000).");
+  parser.add_argument("--max-image-options").type("uint").default_value("10000").help("Largest parser to save and load as an image (10 to 100000 options).");
+  parser.add_argument("--process-runs").type("uint").default_value("200").help("Times to start the empty programs, with and without the library.");
+  parser.add_argument("--iterations").type("uint").default_value("5").help("Parses per sample; the fastest one is reported.");
+  parser.add_argument({"--output", "-o"}).default_value("-").help("Where to write JSON, '-' for stdout.");
+  auto args = parser.parse_args(std::vector<std::string_view>(argv + 1, argv + argc));
+
+  std::vector<Sample> samples;
+  for (std::size_t options = 10; options <= args["max-options"].as_uint64(); options *= 10) {
+    for (std::size_t tokens = 1000; tokens <= args["max-tokens"].as_uint64(); tokens *= 10) {
+      samples.push_back(run(options, tokens, args["iterations"].as_uint64()));
+      const auto& sample = samples.back();
+      std::cerr << "options=" << sample.options << " tokens=" << sample.tokens
+                << " construct=" << sample.construct_ns / 1e6 << "ms"
+                << " help=" << sample.help_ns / 1e6 << "ms"
+                << " clone=" << sample.clone_ns << "ns"
+                << " extend=" << sample.extend_ns << "ns"
+                << " ns/token=" << sample.ns_per_token
+                << " allocs/parse=" << sample.allocations_per_parse
+                << " pooled=" << sample.pooled_allocations_per_parse << '\n';
+    }
+  }
+
+  std::vector<StartupSample> startup;
+  for (std::size_t subcommands : {10, 30, 100, 300, 1000, 3000, 10000}) {
+    if (subcommands > args["max-subcommands"].as_uint64()) {
+      break;
+    }
+    startup.push_back(run_startup(subcommands, args["iterations"].as_uint64()));
+    const auto& sample = startup.back();
+    std::cerr << "subcommands=" << sample.subcommands
+              << " lazy=" << sample.lazy_ns / 1e3 << "us"
+              << " register/command=" << sample.register_ns_per_command << "ns"
+              << " eager=" << sample.eager_ns / 1e3 << "us\n";
+  }
+
+  std::vector<AbbrevSample> abbrev;
+  for (std::size_t flags = 100; flags <= args["max-flags"].as_uint64(); flags *= 10) {
+    abbrev.push_back(run_abbrev(flags, args["iterations"].as_uint64()));
+    const auto& sample = abbrev.back();
+    std::cerr << "flags=" << sample.flags
+              << " exact=" << sample.exact_ns << "ns"
+              << " abbrev=" << sample.abbrev_ns << "ns"
+              << " scan=" << sample.scan_ns << "ns\n";
+  }
+
+  std::vector<DefaultsSample> defaults;
+  for (std::size_t lines = 100; lines <= args["max-defaults"].as_uint64(); lines *= 10) {
+    defaults.push_back(run_defaults(lines, args["iterations"].as_uint64()));
+    const auto& sample = defaults.back();
+    std::cerr << "defaults=" << sample.lines
+              << " load=" << sample.load_ns / 1e3 << "us"
+              << " ns/line=" << sample.ns_per_line
+              << " apply=" << sample.apply_ns / 1e3 << "us"
+              << " json=" << sample.json_load_ns / 1e3 << "us"
+              << " json ns/line=" << sample.json_ns_per_line << '\n';
+  }
+
+  std::vector<ImageSample> images;
+  for (std::size_t options = 10; options <= args["max-image-options"].as_uint64(); options *= 10) {
+    images.push_back(run_image(options, args["iterations"].as_uint64()));
+    const auto& sample = images.back();
+    std::cerr << "image options=" << sample.options
+              << " bytes=" << sample.bytes
+              << " construct=" << sample.construct_ns / 1e3 << "us"
+              << " load=" << sample.load_ns / 1e3 << "us"
+              << " compile=" << sample.compile_ns / 1e3 << "us\n";
+  }
+
+  auto process = run_processes(args["process-runs"].as_uint64());
+  std::cerr << "time-to-main baseline=" << process.baseline_us << "us linked=" << process.linked_us << "us\n";
+
+  if (args["output"].as_view() == "-") {
+    write_json(std::cout, samples, startup, abbrev, defaults, images, process);
+  }
+  else {
+    std::ofstream out(args["output"].as_string());
+    write_json(out, samples, startup, abbrev, defaults, images, process);
+  }
+}
+
+
+// Spreads `options` optionals over `groups` groups, cycling through every action kind and nargs form
+auto make_parser(std::size_t options, std::size_t groups) -> parsing::ArgumentParser {
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("synthetic");
+  parser.add_argument("first");
+  parser.add_argument("rest").nargs("*");
+
+  std::vector<parsing::ActionGroup*> extra;
+  for (std::size_t ix = 0; ix < groups; ++ix) {
+    extra.push_back(&parser.add_argument_group("Group " + std::to_string(ix)));
+  }
+
+  for (std::size_t ix = 0; ix < options; ++ix) {
+    auto& group = *extra[ix % groups];
+    auto name = "--option-" + std::to_string(ix);
+    auto& argument = group.add_argument({name}).help("Synthetic option " + std::to_string(ix) + ".");
+    switch (ix % 13) {
+      case 0: break;
+      case 1: argument.action(parsing::actions::store_true); break;
+      case 2: argument.action(parsing::actions::store_false); break;
+      case 3: argument.action(parsing::actions::store_const).const_value("constant"); break;
+      case 4: argument.action(parsing::actions::append_const).const_value("constant"); break;
+      case 5: argument.action(parsing::actions::count); break;
+      case 6: argument.nargs(2); break;
+      case 7: argument.nargs("+"); break;
+      case 8: argument.type("int").default_value("0"); break;
+      case 9: argument.nargs("?").const_value("constant"); break;
+      case 10: argument.nargs("*"); break;
+      case 11: argument.action(parsing::actions::extend).nargs("+"); break;
+      case 12: argument.action(parsing::actions::append); break;
+    }
+  }
+  return parser;
+}
+
+// Uses every option once (in their own form), then pads with positionals up to `tokens`.
+// Variadic optionals get two values and stop at the next flag; append ones get used twice.
+auto make_argv(std::size_t options, std::size_t tokens) -> std::vector<std::string> {
+  std::vector<std::string> argv {"first"};
+  for (std::size_t ix = 0; ix < options and argv.size() + 4 < tokens; ++ix) {
+    auto name = "--option-" + std::to_string(ix);
+    switch (ix % 13) {
+      case 0: argv.push_back(name + "=value"); break;
+      case 6: case 7: case 10: case 11: argv.push_back(name); argv.push_back("a"); argv.push_back("b"); break;
+      case 8: argv.push_back(name); argv.push_back(std::to_string(ix)); break;
+      case 12: argv.push_back(name + "=a"); argv.push_back(name + "=b"); break;
+      default: argv.push_back(name); break;
+    }
+  }
+  argv.push_back("--");
+  while (argv.size() < tokens) {
+    argv.push_back("/some/path/file-" + std::to_string(argv.size()) + ".txt");
+  }
+  return argv;
+}
+
+auto run(std::size_t options, std::size_t tokens, std::size_t iterations) -> Sample {
+  using clock = std::chrono::steady_clock;
+  auto elapsed = [](clock::time_point since){ return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count()); };
+
+  Sample sample;
+  sample.options = options;
+  sample.groups = std::max<std::size_t>(1, options / 50);
+
+  auto start = clock::now();
+  auto parser = make_parser(options, sample.groups);
+  sample.construct_ns = elapsed(start);
+
+  start = clock::now();
+  parser.compile();
+  sample.compile_ns = elapsed(start);
+
+  // Render help into a buffer rather than the terminal
+  std::ostringstream sink;
+  auto* previous = std::cout.rdbuf(sink.rdbuf());
+  start = clock::now();
+  parser.show_help();
+  sample.help_ns = elapsed(start);
+  std::cout.rdbuf(previous);
+
+  sample.clone_ns = sample.extend_ns = 1e300;
+  for (std::size_t ix = 0; ix < std::max<std::size_t>(1, iterations); ++ix) {
+    start = clock::now();
+    parsing::ArgumentParser tenant = parser;
+    sample.clone_ns = std::min(sample.clone_ns, elapsed(start));
+    start = clock::now();
+    tenant.add_argument("--tenant");
+    sample.extend_ns = std::min(sample.extend_ns, elapsed(start));
+  }
+
+  auto storage = make_argv(options, tokens);
+  std::vector<std::string_view> argv(storage.begin(), storage.end());
+  sample.tokens = argv.size();
+
+  sample.parse_ns = 1e300;
+  for (std::size_t ix = 0; ix < std::max<std::size_t>(1, iterations); ++ix) {
+    auto before = allocation_count.load();
+    start = clock::now();
+    auto parsed = parser.try_parse_args(argv);
+    auto took = elapsed(start);
+    auto allocations = allocation_count.load() - before;
+    if (not parsed) {
+      std::cerr << "synthetic argv failed to parse: " << parsed.error.message() << '\n';
+      std::exit(1);
+    }
+    if (took < sample.parse_ns) {
+      sample.parse_ns = took;
+      sample.allocations_per_parse = double(allocations);
+    }
+  }
+  sample.ns_per_token = sample.parse_ns / double(sample.tokens);
+
+  // As a request-handling worker would: one buffer, released after every parse
+  std::vector<std::byte> buffer(argv.size() * 256 + options * 256 + 4096);
+  std::pmr::monotonic_buffer_resource pool(buffer.data(), buffer.size());
+  sample.pooled_allocations_per_parse = 1e300;
+  for (std::size_t ix = 0; ix < std::max<std::size_t>(1, iterations); ++ix) {
+    auto before = allocation_count.load();
+    {
+      auto parsed = parser.try_parse_args(argv, &pool);
+    }
+    pool.release();
+    sample.pooled_allocations_per_parse = std::min(sample.pooled_allocations_per_parse, double(allocation_count.load() - before));
+  }
+  sample.peak_rss_kb = peak_rss_kb();
+  return sample;
+}
+
+// Startup of a multi-tool with `subcommands` commands of 20 options each: registering them all
+// lazily and parsing one, against building every command's options into one parser up front.
+// Registering a command should cost the same however many came before it, so the per-command
+// figure is expected to stay flat as the count grows.
+auto run_startup(std::size_t subcommands, std::size_t iterations) -> StartupSample {
+  using clock = std::chrono::steady_clock;
+  auto elapsed = [](clock::time_point since){ return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count()); };
+  auto command = "cmd-" + std::to_string(subcommands / 2);
+  std::vector<std::string_view> argv {command, "--option-3", "value"};
+  auto eager_flag = "--" + command + "-option-3";
+  std::vector<std::string_view> eager_argv {eager_flag, "value"};
+
+  StartupSample sample;
+  sample.subcommands = subcommands;
+  std::vector<std::string> names;
+  for (std::size_t ix = 0; ix < subcommands; ++ix) {
+    names.push_back("cmd-" + std::to_string(ix));
+  }
+  sample.lazy_ns = sample.register_ns_per_command = sample.eager_ns = 1e300;
+  for (std::size_t iteration = 0; iteration < std::max<std::size_t>(1, iterations); ++iteration) {
+    auto start = clock::now();
+    {
+      parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("multi-tool");
+      auto& commands = parser.add_subparsers();
+      auto registering = clock::now();
+      for (auto& name : names) {
+        commands.add_parser(name, [](parsing::ArgumentParser& sub){
+          for (std::size_t option = 0; option < 20; ++option) {
+            sub.add_argument("--option-" + std::to_string(option)).help("Synthetic option.");
+          }
+        }, "Synthetic command.");
+      }
+      sample.register_ns_per_command = std::min(sample.register_ns_per_command, elapsed(registering) / double(subcommands));
+      if (not parser.try_parse_args(argv)) {
+        std::cerr << "lazy startup failed to parse\n";
+        std::exit(1);
+      }
+    }
+    sample.lazy_ns = std::min(sample.lazy_ns, elapsed(start));
+
+    start = clock::now();
+    {
+      parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("multi-tool");
+      for (std::size_t ix = 0; ix < subcommands; ++ix) {
+        auto& group = parser.add_argument_group("cmd-" + std::to_string(ix));
+        for (std::size_t option = 0; option < 20; ++option) {
+          group.add_argument({"--cmd-" + std::to_string(ix) + "-option-" + std::to_string(option)}).help("Synthetic option.");
+        }
+      }
+      if (not parser.try_parse_args(eager_argv)) {
+        std::cerr << "eager startup failed to parse\n";
+        std::exit(1);
+      }
+    }
+    sample.eager_ns = std::min(sample.eager_ns, elapsed(start));
+  }
+  return sample;
+}
+
+// Per-lookup cost of resolving every flag of a `flags`-flag parser, exactly and abbreviated (by
+// dropping the unique "-end" tail), through the trie, against scanning all flags for the prefix
+auto run_abbrev(std::size_t flags, std::size_t iterations) -> AbbrevSample {
+  using clock = std::chrono::steady_clock;
+  auto elapsed = [](clock::time_point since){ return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count()); };
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("abbrev");
+  std::vector<std::string> exact;
+  std::vector<std::string> shortened;
+  for (std::size_t ix = 0; ix < flags; ++ix) {
+    exact.push_back("--flag-" + std::to_string(ix) + "-end");
+    shortened.push_back("--flag-" + std::to_string(ix) + "-e");
+    parser.add_argument(exact.back());
+  }
+  parser.compile();
+  const auto& table = *parser.flag_table;
+
+  AbbrevSample sample;
+  sample.flags = flags;
+  sample.exact_ns = sample.abbrev_ns = sample.scan_ns = 1e300;
+  std::size_t found = 0;
+  for (std::size_t iteration = 0; iteration < std::max<std::size_t>(1, iterations); ++iteration) {
+    auto start = clock::now();
+    for (auto& flag : exact) {
+      found += table.match(flag, std::string_view::npos, true).action != nullptr;
+    }
+    sample.exact_ns = std::min(sample.exact_ns, elapsed(start) / double(flags));
+
+    start = clock::now();
+    for (auto& flag : shortened) {
+      found += table.match(flag, std::string_view::npos, true).action != nullptr;
+    }
+    sample.abbrev_ns = std::min(sample.abbrev_ns, elapsed(start) / double(flags));
+
+    // The naive version only gets a tenth of the lookups, or the large sizes take minutes
+    start = clock::now();
+    std::size_t scanned = 0;
+    for (std::size_t ix = 0; ix < shortened.size(); ix += 10, ++scanned) {
+      std::size_t hits = 0;
+      for (auto& flag : exact) {
+        hits += flag.compare(0, shortened[ix].size(), shortened[ix]) == 0;
+      }
+      found += hits == 1;
+    }
+    sample.scan_ns = std::min(sample.scan_ns, elapsed(start) / double(scanned));
+  }
+  if (found == 0) {
+    std::cerr << "abbreviation lookups found nothing\n";
+    std::exit(1);
+  }
+  return sample;
+}
+
+// Time to map, parse and validate a generated `lines`-line defaults file for a parser with as many
+// options (a third of them typed), as INI and as JSON, and to apply all of it in a parse of an
+// empty command line
+auto run_defaults(std::size_t lines, std::size_t iterations) -> DefaultsSample {
+  using clock = std::chrono::steady_clock;
+  auto elapsed = [](clock::time_point since){ return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count()); };
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("defaults");
+  std::string path = scratch_file(".ini");
+  std::string json_path = scratch_file(".json");
+  {
+    std::ofstream out(path);
+    std::ofstream json(json_path);
+    out << "# generated\n[synthetic]\n";
+    json << "{";
+    for (std::size_t ix = 0; ix < lines; ++ix) {
+      auto& argument = parser.add_argument("--option-" + std::to_string(ix));
+      json << (ix == 0 ? "\n" : ",\n") << "  \"option-" << ix << "\": ";
+      if (ix % 3 == 0) {
+        argument.type("int");
+        out << "option-" << ix << " = " << ix << '\n';
+        json << ix;
+      }
+      else {
+        out << "option-" << ix << " = \"value " << ix << "\"\n";
+        json << "\"value " << ix << '"';
+      }
+    }
+    json << "\n}\n";
+  }
+  parser.compile();
+
+  DefaultsSample sample;
+  sample.lines = lines;
+  sample.load_ns = sample.apply_ns = sample.json_load_ns = 1e300;
+  std::vector<std::string_view> empty;
+  for (std::size_t iteration = 0; iteration < std::max<std::size_t>(1, iterations); ++iteration) {
+    parser.m.defaults_files.clear();
+    auto start = clock::now();
+    auto loaded = parser.try_load_defaults(path);
+    sample.load_ns = std::min(sample.load_ns, elapsed(start));
+    if (not loaded) {
+      std::cerr << loaded.error.message() << '\n';
+      std::exit(1);
+    }
+
+    start = clock::now();
+    auto parsed = parser.try_parse_args(empty);
+    sample.apply_ns = std::min(sample.apply_ns, elapsed(start));
+    if (not parsed or parsed.values[std::string_view("option-0")].as_view() != "0") {
+      std::cerr << "defaults file did not apply\n";
+      std::exit(1);
+    }
+
+    parser.m.defaults_files.clear();
+    start = clock::now();
+    loaded = parser.try_load_defaults(json_path);
+    sample.json_load_ns = std::min(sample.json_load_ns, elapsed(start));
+    if (not loaded) {
+      std::cerr << loaded.error.message() << '\n';
+      std::exit(1);
+    }
+  }
+  sample.ns_per_line = sample.load_ns / double(lines);
+  sample.json_ns_per_line = sample.json_load_ns / double(lines);
+  std::remove(path.c_str());
+  std::remove(json_path.c_str());
+  return sample;
+}
+
+// Building a parser with add_argument against loading the same one from a saved image, and then
+// compiling each (the loaded one reuses the image's flag trie)
+auto run_image(std::size_t options, std::size_t iterations) -> ImageSample {
+  using clock = std::chrono::steady_clock;
+  auto elapsed = [](clock::time_point since){ return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count()); };
+  constexpr auto fingerprint = parsing::fnv1a("parsing-bench synthetic");
+  std::string path = scratch_file(".image");
+
+  ImageSample sample;
+  sample.options = options;
+  sample.construct_ns = sample.load_ns = sample.compile_ns = 1e300;
+  for (std::size_t iteration = 0; iteration < std::max<std::size_t>(1, iterations); ++iteration) {
+    auto start = clock::now();
+    auto built = make_parser(options, 10);
+    sample.construct_ns = std::min(sample.construct_ns, elapsed(start));
+    if (iteration == 0 and not built.save_image(path, fingerprint)) {
+      std::cerr << "could not save " << path << '\n';
+      std::exit(1);
+    }
+
+    start = clock::now();
+    auto loaded = parsing::ArgumentParser::load_image(path, fingerprint);
+    sample.load_ns = std::min(sample.load_ns, elapsed(start));
+    if (not loaded or loaded->m.core->size() != built.m.core->size()) {
+      std::cerr << "could not load " << path << '\n';
+      std::exit(1);
+    }
+    start = clock::now();
+    loaded->compile();
+    sample.compile_ns = std::min(sample.compile_ns, elapsed(start));
+  }
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  sample.bytes = static_cast<std::size_t>(in.tellg());
+  std::remove(path.c_str());
+  return sample;
+}
+
+// Spawns the empty programs from bench/startup.cpp in turns and averages their wall time, so the
+// difference is what linking the library adds before main (static initializers, mostly)
+auto run_processes(std::size_t runs) -> ProcessSample {
+  using clock = std::chrono::steady_clock;
+  std::string baseline = std::string(PARSING_STARTUP_DIR) + "/parsing-startup-baseline";
+  std::string linked = std::string(PARSING_STARTUP_DIR) + "/parsing-startup-linked";
+  auto once = [](std::string& path) {
+    char* argv[] = {path.data(), nullptr};
+    char* envp[] = {nullptr};
+    pid_t pid = 0;
+    auto start = clock::now();
+    if (posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv, envp) != 0) {
+      std::cerr << "cannot run " << path << '\n';
+      std::exit(1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count()) / 1e3;
+  };
+
+  ProcessSample sample;
+  runs = std::max<std::size_t>(1, runs);
+  for (std::size_t ix = 0; ix < runs; ++ix) {
+    sample.baseline_us += once(baseline);
+    sample.linked_us += once(linked);
+  }
+  sample.baseline_us /= double(runs);
+  sample.linked_us /= double(runs);
+  return sample;
+}
+
+auto peak_rss_kb() -> long {
+  rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Creates an empty file with a unique name in the temporary directory, so runs side by side
+// never write over each other's fixtures
+auto scratch_file(const std::string& suffix) -> std::string {
+  auto path = (std::filesystem::temp_directory_path() / ("parsing-bench-XXXXXX" + suffix)).string();
+  int fd = mkstemps(path.data(), static_cast<int>(suffix.size()));
+  if (fd < 0) {
+    std::cerr << "could not create a file in " << std::filesystem::temp_directory_path() << '\n';
+    std::exit(1);
+  }
+  close(fd);
+  return path;
+}
+
+void write_json(std::ostream& out, const std::vector<Sample>& samples, const std::vector<StartupSample>& startup, const std::vector<AbbrevSample>& abbrev, const std::vector<DefaultsSample>& defaults, const std::vector<ImageSample>& images, const ProcessSample& process) {
+  out << "{\"benchmark\": \"parsing-bench\", \"samples\": [";
+  for (std::size_t ix = 0; ix < samples.size(); ++ix) {
+    const auto& sample = samples[ix];
+    out << (ix == 0 ? "\n" : ",\n")
+        << "  {\"options\": " << sample.options
+        << ", \"groups\": " << sample.groups
+        << ", \"tokens\": " << sample.tokens
+        << ", \"construct_ns\": " << sample.construct_ns
+        << ", \"compile_ns\": " << sample.compile_ns
+        << ", \"help_ns\": " << sample.help_ns
+        << ", \"clone_ns\": " << sample.clone_ns
+        << ", \"extend_ns\": " << sample.extend_ns
+        << ", \"parse_ns\": " << sample.parse_ns
+        << ", \"ns_per_token\": " << sample.ns_per_token
+        << ", \"allocations_per_parse\": " << sample.allocations_per_parse
+        << ", \"pooled_allocations_per_parse\": " << sample.pooled_allocations_per_parse
+        << ", \"peak_rss_kb\": " << sample.peak_rss_kb << "}";
+  }
+  out << "\n], \"startup\": [";
+  for (std::size_t ix = 0; ix < startup.size(); ++ix) {
+    const auto& sample = startup[ix];
+    out << (ix == 0 ? "\n" : ",\n")
+        << "  {\"subcommands\": " << sample.subcommands
+        << ", \"lazy_ns\": " << sample.lazy_ns
+        << ", \"register_ns_per_command\": " << sample.register_ns_per_command
+        << ", \"eager_ns\": " << sample.eager_ns << "}";
+  }
+  out << "\n], \"abbrev\": [";
+  for (std::size_t ix = 0; ix < abbrev.size(); ++ix) {
+    const auto& sample = abbrev[ix];
+    out << (ix == 0 ? "\n" : ",\n")
+        << "  {\"flags\": " << sample.flags
+        << ", \"exact_ns\": " << sample.exact_ns
+        << ", \"abbrev_ns\": " << sample.abbrev_ns
+        << ", \"scan_ns\": " << sample.scan_ns << "}";
+  }
+  out << "\n], \"defaults\": [";
+  for (std::size_t ix = 0; ix < defaults.size(); ++ix) {
+    const auto& sample = defaults[ix];
+    out << (ix == 0 ? "\n" : ",\n")
+        << "  {\"lines\": " << sample.lines
+        << ", \"load_ns\": " << sample.load_ns
+        << ", \"ns_per_line\": " << sample.ns_per_line
+        << ", \"apply_ns\": " << sample.apply_ns
+        << ", \"json_load_ns\": " << sample.json_load_ns
+        << ", \"json_ns_per_line\": " << sample.json_ns_per_line << "}";
+  }
+  out << "\n], \"images\": [";
+  for (std::size_t ix = 0; ix < images.size(); ++ix) {
+    const auto& sample = images[ix];
+    out << (ix == 0 ? "\n" : ",\n")
+        << "  {\"options\": " << sample.options
+        << ", \"bytes\": " << sample.bytes
+        << ", \"construct_ns\": " << sample.construct_ns
+        << ", \"load_ns\": " << sample.load_ns
+        << ", \"compile_ns\": " << sample.compile_ns << "}";
+  }
+  out << "\n], \"time_to_main\": {\"baseline_us\": " << process.baseline_us << ", \"linked_us\": " << process.linked_us << "}}\n";
+  out.flush();
+}
@@ -0,0 +1,18 @@
+#include <iostream>
+#include <string>
+
+#ifdef PARSING_STARTUP_LINKED
+#include "parsing.hpp"
+
+// Referencing the library pulls its objects (and their static initializers) into the binary
+auto (*volatile keep)(std::string, std::pmr::memory_resource*) -> parsing::ArgumentParser = &parsing::ArgumentParser::create_parser;
+#else
+// The baseline is still a C++ program with iostreams, so only the library itself is measured
+std::ostream* volatile keep = &std::cout;
+#endif
+
+
+// Returns from main straight away, so running it measures process start plus static init
+int main() {
+  return 0;
+}
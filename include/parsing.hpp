@@ -1,6 +1,20 @@
 #pragma once
 
 #include "parsing/utils.hpp"
+#include "parsing/stats.hpp"
 #include "parsing/action.hpp"
 #include "parsing/actiongroup.hpp"
+#include "parsing/parsercore.hpp"
+#include "parsing/flagtable.hpp"
+#include "parsing/lexer.hpp"
+#include "parsing/namespace.hpp"
+#include "parsing/parseresult.hpp"
+#include "parsing/shell.hpp"
+#include "parsing/responsefile.hpp"
+#include "parsing/defaultsfile.hpp"
+#include "parsing/image.hpp"
+#include "parsing/records.hpp"
+#include "parsing/subparsers.hpp"
+#include "parsing/completion.hpp"
 #include "parsing/argumentparser.hpp"
+#include "parsing/spec.hpp"
@@ -3,9 +3,11 @@
 #include <algorithm>
 #include <cstdint>
 #include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <locale>
+#include <memory_resource>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -16,25 +18,49 @@
 
 namespace parsing {
   // Action declaration
+  //
+  // Allocator-aware: every string lives in the memory resource the action was built with, which
+  // containers such as ActionGroup::arguments pass down on their own.
   struct Action {
-    std::vector<std::string> flags_;
-    std::string flags_string_;
-    bool required_;
-    std::string dest_;
-    std::string metavar_;
-    argtypes argtype_;
-    std::string type_ {"string"};
-    std::string default_ {""};
-    std::string const_ {""};
-    std::string nargs_ {"@"};
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    std::pmr::vector<std::pmr::string> flags_;
+    std::pmr::string flags_string_;
+    bool required_ = false;
+    std::pmr::string dest_;
+    std::pmr::string metavar_;
+    argtypes argtype_ {argtypes::positional};
+    std::pmr::string type_ {"string"};
+    valuetypes valuetype_ {valuetypes::string};
+    std::pmr::string default_ {""};
+    std::pmr::string const_ {""};
+    nargstypes nargs_ {nargstypes::exact};
     actions action_ {actions::store};
     std::size_t min_nargs_ = 1;
     std::size_t max_nargs_ = 1;
-    std::unordered_map<std::string, bool> user_provided;
-    std::string help_ {""};
+    // One bit per setter already called (see _check)
+    std::uint16_t user_provided = 0;
+    std::pmr::string help_ {""};
+    // Numbers the actions of the ParserCore that holds this one (see ParserCore::index)
+    std::size_t index_ = 0;
+    const ParserCore* core_ = nullptr;
+    std::function<void(std::string_view)> stream_;
+    bool stream_stdin_ = false;
+    std::pmr::string env_;
+
+    // Blank, for filling in field by field when loading a ParserImage
+    Action() : Action(allocator_type()) {}
+    explicit Action(const allocator_type& alloc);
+    explicit Action(const std::string& value, const allocator_type& alloc = {});
+    explicit Action(const std::initializer_list<std::string>& values, const allocator_type& alloc = {});
+    Action(const Action& other) = default;
+    Action(Action&& other) = default;
+    Action(const Action& other, const allocator_type& alloc);
+    Action(Action&& other, const allocator_type& alloc);
+    Action& operator=(const Action& other) = default;
+    Action& operator=(Action&& other) = default;
 
-    explicit Action(const std::string& value);
-    explicit Action(const std::initializer_list<std::string>& values);
+    auto get_allocator() const -> allocator_type;
     auto dest(const std::string& value) -> Action&;
     auto nargs(const std::string& value) -> Action&;
     auto nargs(std::size_t value) -> Action&;
@@ -45,8 +71,18 @@ namespace parsing {
     auto metavar(const std::string& value) -> Action&;
     auto help(const std::string& value) -> Action&;
     auto required(bool value) -> Action&;
+    // Variadic positionals only: values go to `callback` once the parse succeeds, not the namespace
+    // (they're still tokenized up front with the rest of the command line, see ResponseFiles)
+    auto stream(std::function<void(std::string_view)> callback) -> Action&;
+    // With stream(): a lone "-" reads NUL-delimited values from standard input instead
+    auto stream_stdin(bool value) -> Action&;
+    // Optionals only: when absent from the command line, take the value of this environment
+    // variable (if it's set) before falling back to the default. It's read as a defaults file
+    // line would be: split on whitespace and held to nargs, or a boolean for flags (a number for
+    // count)
+    auto env(const std::string& name) -> Action&;
   private:
-    void _check(const std::string& method);
+    void _check(std::string_view method);
   };
 
 }
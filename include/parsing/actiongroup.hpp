@@ -6,6 +6,7 @@
 #include <iomanip>
 #include <iostream>
 #include <locale>
+#include <memory_resource>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -18,16 +19,30 @@
 
 namespace parsing {
   // ActionGroup declaration
+  //
+  // Allocator-aware like Action, and hands its resource down to the actions it holds.
   struct ActionGroup {
-    ArgumentParser& parent;
-    std::string name;
-    std::deque<Action> arguments;
-    std::unordered_map<std::string, Action&> flags;
-
-    ActionGroup(ArgumentParser& parent, std::string name);
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    ArgumentParser* parent;
+    std::pmr::string name;
+    std::pmr::deque<Action> arguments;
+    std::pmr::unordered_map<std::pmr::string, Action&> flags;
+
+    ActionGroup(ArgumentParser& parent, std::string_view name, const allocator_type& alloc = {});
+    // Copies get their own `flags`, pointing at their own actions
+    ActionGroup(const ActionGroup& other);
+    ActionGroup(ActionGroup&& other) = default;
+    ActionGroup(const ActionGroup& other, const allocator_type& alloc);
+    ActionGroup(ActionGroup&& other, const allocator_type& alloc);
+    // Assignment keeps this group's allocator, so the actions may be copied over one by one
+    ActionGroup& operator=(const ActionGroup& other);
+    ActionGroup& operator=(ActionGroup&& other);
 
     auto add_argument(const std::string& value) -> Action&;
     auto add_argument(const std::initializer_list<std::string>& values) -> Action&;
+    // Rebuilds `flags` from the arguments
+    void reindex();
   };
 
 
@@ -3,11 +3,15 @@
 #include <algorithm>
 #include <cstdint>
 #include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #include <locale>
+#include <memory_resource>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -15,6 +19,18 @@
 #include "parsing/utils.hpp"
 #include "parsing/action.hpp"
 #include "parsing/actiongroup.hpp"
+#include "parsing/parsercore.hpp"
+#include "parsing/flagtable.hpp"
+#include "parsing/lexer.hpp"
+#include "parsing/namespace.hpp"
+#include "parsing/parseresult.hpp"
+#include "parsing/shell.hpp"
+#include "parsing/responsefile.hpp"
+#include "parsing/defaultsfile.hpp"
+#include "parsing/image.hpp"
+#include "parsing/records.hpp"
+#include "parsing/subparsers.hpp"
+#include "parsing/completion.hpp"
 
 
 namespace parsing {
@@ -25,27 +41,134 @@ namespace parsing {
       std::string version = "";
       std::string usage = "";
       std::string description = "";
-      std::deque<ActionGroup> groups = {};
+      // The groups and their arguments, shared with copies of this parser and with parsers
+      // naming it as a parent (see ParserCore)
+      std::shared_ptr<ParserCore> core = nullptr;
       bool explicit_name = false;
       bool help_added = false;
       bool help_removed = false;
+      // Arguments starting with one of these name a file to read more arguments from
+      std::string fromfile_prefix_chars = "";
+      rspmodes fromfile_mode = rspmodes::newline;
+      // Empty, or the one set of subcommands from add_subparsers (a deque, so it never moves)
+      std::deque<Subparsers> subparsers = {};
+      // Like argparse, "--verb" stands for "--verbose" when no other long flag starts that way
+      bool allow_abbrev = true;
+      // Loaded by load_defaults, oldest first; later files win over earlier ones
+      std::vector<std::shared_ptr<const DefaultsFile>> defaults_files = {};
+      // Set when loaded from an image, until the parser is changed: compile() reads the flag
+      // trie straight out of it instead of building one
+      std::shared_ptr<const ParserImage> image = nullptr;
     } m;
+    // Built by compile(), and shared by copies for as long as nothing is added to either
+    std::shared_ptr<const FlagTable> flag_table;
+    std::shared_ptr<const DestTable> dest_table;
 
     explicit ArgumentParser(M m);
 
+    // Copies share the core and the compiled tables, so they cost the same whatever the parser's
+    // size; whichever side adds arguments afterwards gets a layer of its own (see ParserCore).
+    // The actions already there are shared too, so finish setting them up before copying.
     ArgumentParser(const ArgumentParser& other);
     ArgumentParser& operator=(const ArgumentParser& other);
     ArgumentParser(ArgumentParser&& other);
     ArgumentParser& operator=(ArgumentParser&& other);
 
-    static ArgumentParser create_parser(std::string value);
+    // Arguments, groups and their strings are allocated from `resource`, which has to outlive
+    // the parser and its copies.
+    static ArgumentParser create_parser(std::string value, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // Like argparse's parents=[...]: the new parser starts out with every argument of `parents`,
+    // shared with them rather than copied, so this costs the same whatever their size. Parents
+    // keep working as they are; anything added to one afterwards stays its own. The new parser
+    // only adds -h/--help if no parent has it; two parents both taking a flag is an error.
+    static ArgumentParser create_parser(std::string value, const std::vector<std::reference_wrapper<const ArgumentParser>>& parents, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // A parser saved by save_image with the same fingerprint, or nothing if there's no such
+    // image (missing, from another build of the library, or for a different fingerprint), in
+    // which case build the parser as usual and save it for next time. Arguments are copied out
+    // of the image as they are, with none of add_argument's checks or derivations; defaults
+    // files are not part of the image.
+    static auto load_image(const std::string& path, std::uint64_t fingerprint) -> std::optional<ArgumentParser>;
 
+    auto resource() const -> std::pmr::memory_resource*;
     auto add_argument_group(const std::string& name) -> ActionGroup&;
+    // The group to add to in place of `group`: `group` itself while this parser's core is its
+    // own, otherwise its namesake in the new core this parser layers over the shared one
+    auto writable(const ActionGroup& group) -> ActionGroup&;
     auto add_argument(const std::string& value) -> Action&;
     auto add_argument(const std::initializer_list<std::string>& values) -> Action&;
     void add_help(bool value);
+    // The first free positional after this parser's own (which take exactly their minimum
+    // count) names the subcommand; everything after it is handed to that subcommand's parser
+    auto add_subparsers(const std::string& title = "Commands") -> Subparsers&;
     void show_help() const;
-    auto parse_args(const std::deque<std::string>& values) const -> std::unordered_map<std::string, Result>;
-    auto parse_args(int argc, char** argv) const -> std::unordered_map<std::string, Result>;
+    // Every flag and subcommand, down through all the subcommands (so each of their parsers
+    // gets built here). A build-time step: save the result for handle_completion rather than
+    // calling this when completing (see completion.hpp)
+    auto completion_index() const -> std::string;
+    void compile();
+    void invalidate();
+    // Writes this parser to `path` (through a temporary file, so readers never see half of it);
+    // false if it has subcommands or stream() callbacks, or the file can't be written
+    auto save_image(const std::string& path, std::uint64_t fingerprint) const -> bool;
+    // Reads defaults keyed by dest from an INI-style or flat JSON file (see DefaultsFile), for
+    // the arguments added so far. They apply below the command line and Action::env but above
+    // default_value, and are checked against each argument's nargs and type here, once. The
+    // file stays mapped for as long as the parser (or a copy of it) is alive.
+    void load_defaults(const std::string& path);
+    // Same, but errors come back instead of exiting
+    auto try_load_defaults(const std::string& path) -> ParseResult;
+    // Results hold views into the values passed in (and into this parser for defaults and
+    // constants), so both have to outlive the returned namespace.
+    auto parse_args(const std::vector<std::string_view>& args) const -> Namespace;
+    auto parse_args(const std::vector<std::string_view>& args, std::pmr::memory_resource* resource) const -> Namespace;
+    auto parse_args(const std::deque<std::string>& values) const -> Namespace;
+    auto parse_args(std::deque<std::string>&& values) const -> Namespace = delete;
+    auto parse_args(int argc, char** argv) const -> Namespace;
+    // Splits one command line with ShellTokenizer (passing `expand` along for $VAR) and parses the
+    // words. They're views into `line` unless they needed unescaping, so `line` has to outlive the
+    // namespace too; rebuilt words are kept alive by the namespace itself, and like the arena they
+    // come from `resource`.
+    auto parse_line(std::string_view line, ShellTokenizer::expander expand = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const -> Namespace;
+    // argparse's name for a parse where positionals can sit between optionals (`cp a -v b dir`)
+    // and still fill their arguments in order. parse_args already reads positionals that way, so
+    // these are the same parse, kept under argparse's name for code ported from it.
+    auto parse_intermixed_args(const std::vector<std::string_view>& args) const -> Namespace;
+    auto parse_intermixed_args(int argc, char** argv) const -> Namespace;
+
+    // Same as parse_args, but never exits: errors, --help and --version come back as outcomes.
+    //
+    // Given a `resource`, the namespace's arena (and the parsers of any subcommand) take their
+    // memory from it instead of the default resource, so a caller can parse into a
+    // monotonic_buffer_resource and drop everything at once; the resource has to outlive the
+    // result. Compile the parser first, or its tables are built per call on the default one.
+    auto try_parse_args(const std::vector<std::string_view>& args, std::pmr::memory_resource* resource) const -> ParseResult;
+    auto try_parse_args(const std::vector<std::string_view>& args) const -> ParseResult;
+    auto try_parse_args(const std::deque<std::string>& values) const -> ParseResult;
+    auto try_parse_args(std::deque<std::string>&& values) const -> ParseResult = delete;
+    auto try_parse_args(int argc, char** argv) const -> ParseResult;
+    auto try_parse_line(std::string_view line, ShellTokenizer::expander expand = {}, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const -> ParseResult;
+    auto try_parse_intermixed_args(const std::vector<std::string_view>& args) const -> ParseResult;
+    auto try_parse_intermixed_args(int argc, char** argv) const -> ParseResult;
+
+    // Parses every command line in `batch` on `threads` threads (0 for one per core) and returns
+    // the results in the same order. Each result holds views into its own command line.
+    //
+    // Parsing only reads the parser, so try_parse_args and parse_batch are safe to call from
+    // any number of threads at once, as long as nothing modifies the parser meanwhile and any
+    // stream() callbacks are themselves thread-safe. Call compile() first to share one set of
+    // tables rather than building them per call.
+    //
+    // `resource_for(ix)`, when given, picks the memory resource item `ix` is parsed into (see
+    // try_parse_args); it's called from the worker threads, so what it hands out must be safe to
+    // use from whichever thread asks, e.g. one resource per item or a synchronized pool.
+    auto parse_batch(const std::vector<std::vector<std::string_view>>& batch, std::size_t threads = 0, const std::function<std::pmr::memory_resource*(std::size_t ix)>& resource_for = {}) const -> std::vector<ParseResult>;
+  private:
+    void _own();
+    void _build_flags(FlagTable& table) const;
+    void _completion_entries(const std::string& scope, std::string& index) const;
+    auto _tables(FlagTable& local_table, std::shared_ptr<const DestTable>& layout) const -> const FlagTable&;
+    auto _try_parse(ArgSpan args, const FlagTable& table, const std::shared_ptr<const DestTable>& layout, std::pmr::memory_resource* resource) const -> ParseResult;
+    auto _parse(ArgSpan args, const FlagTable& table, const std::shared_ptr<const DestTable>& layout, std::pmr::memory_resource* resource) const -> ParseResult;
+    auto _unwrap(ParseResult&& parsed) const -> Namespace;
   };
 }
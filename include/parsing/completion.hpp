@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+
+
+namespace parsing {
+  enum struct shells: std::uint8_t {bash, zsh, fish};
+
+  inline constexpr std::string_view completion_header = "parsing-completion 1\n";
+
+  // Shell completion
+  //
+  // The generated scripts run `<program> --_complete <cword> <words...>` on every TAB, where
+  // `words` is the whole command line (program name first) and `cword` indexes the word being
+  // completed. That gets answered from a completion index: plain text, one "<scope>\t<word>"
+  // line per flag or subcommand, where the scope is the space-separated subcommand path ("" at
+  // the top).
+  //
+  // ArgumentParser::completion_index() produces one, but it builds every subcommand's parser,
+  // all the way down, to do it. Generate it at build time, save it (a file next to the binary,
+  // or compiled in), and hand the saved index to handle_completion() first thing in main,
+  // before any parser exists. Calling completion_index() on the TAB path instead builds every
+  // subcommand on each keystroke, which is exactly the cost lazy subcommands exist to avoid.
+  auto complete(std::string_view index, const std::vector<std::string_view>& words, std::size_t cword) -> std::vector<std::string_view>;
+  // If argv is a --_complete request, prints the candidates one per line and returns true
+  auto handle_completion(std::string_view index, int argc, char** argv, std::ostream& out = std::cout) -> bool;
+  auto completion_script(shells shell, const std::string& program) -> std::string;
+}
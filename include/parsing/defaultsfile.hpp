@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <forward_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/parseresult.hpp"
+#include "parsing/responsefile.hpp"
+
+
+namespace parsing {
+  // DefaultsFile declaration
+  //
+  // Defaults for a parser read from a mapped file, keyed by dest. Two formats are understood:
+  //
+  //   # comments start with '#' or ';', [sections] are only for grouping
+  //   jobs = 8
+  //   name = "quoted values keep their spaces"
+  //   sources = a.txt b.txt        (split on whitespace for arguments taking several values)
+  //
+  // or, when the first thing in the file is '{', one flat JSON object whose members are strings,
+  // numbers, booleans, null (no default) or arrays of those. Keys and values are views into the
+  // mapping; only JSON strings with escapes are copied, into `owned`. A key given twice keeps the
+  // last value.
+  struct DefaultsFile {
+    struct Entry {
+      std::string_view key;
+      std::size_t first = 0;
+      std::size_t count = 0;
+      std::size_t line = 0;
+      // A JSON array, rather than one value that may still need splitting
+      bool list = false;
+    };
+
+    std::string path;
+    MappedFile file;
+    std::forward_list<std::string> owned;
+    std::vector<std::string_view> values;
+    std::vector<Entry> entries;
+    // Filled in by the parser: each action's values, as [offset, count) into `resolved`,
+    // indexed by ParserCore::index
+    std::vector<std::string_view> resolved;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+
+    auto load(const std::string& path, ParseError& error) -> bool;
+    // The values this file gives the action with this index (none if it gives none)
+    auto lookup(std::size_t index) const -> std::pair<const std::string_view*, std::size_t>;
+  private:
+    auto _load_ini(std::string_view text, ParseError& error) -> bool;
+    auto _load_json(std::string_view text, ParseError& error) -> bool;
+  };
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/action.hpp"
+#include "parsing/actiongroup.hpp"
+#include "parsing/parsercore.hpp"
+
+
+namespace parsing {
+  // FlagTable declaration
+  //
+  // Every flag across every group in one compressed radix trie, laid out flat: each node holds
+  // the label of the edge leading to it, and its children sit next to each other, sorted by
+  // first character. Resolving a token walks it once, so exact lookups, --flag=value splits
+  // and abbreviations all cost O(length) however many flags there are. Labels and flags are
+  // views into the parser's groups, so the table is only valid for as long as the parser it
+  // was built from is alive and unchanged.
+  struct FlagTable {
+    struct Node {
+      std::string_view label;
+      std::string_view flag;
+      std::uint32_t first_child = 0;
+      std::uint32_t child_count = 0;
+      // A flag ends here
+      const Action* action = nullptr;
+      // The one action every flag below here belongs to, or null if there are several
+      const Action* unique = nullptr;
+    };
+
+    struct Match {
+      const Action* action = nullptr;
+      // How much of the token is the flag; anything after that is "=value"
+      std::size_t length = 0;
+      bool ambiguous = false;
+      std::uint32_t node = 0;
+    };
+
+    std::vector<Node> nodes;
+    // First character of each node's label, so picking a child scans adjacent bytes
+    std::vector<char> keys;
+    // Single-character flags ("-x") by character, so a "-xzf" cluster is one load per letter
+    std::array<const Action*, 256> shorts {};
+    bool compiled = false;
+    bool numeric_flags = false;
+
+    void build(const ParserCore& core);
+    void clear();
+    auto find(std::string_view flag) const -> const Action*;
+    // Exact flag first, then the part before `eq`, then (if allowed, and only for "--" flags)
+    // the one flag the token abbreviates
+    auto match(std::string_view text, std::size_t eq, bool allow_abbrev) const -> Match;
+    // Every flag an ambiguous match could have meant
+    auto candidates(const Match& match) const -> std::vector<std::string_view>;
+
+    static constexpr std::uint32_t npos = UINT32_MAX;
+  private:
+    auto _descend(std::string_view text, bool& partial) const -> std::uint32_t;
+  };
+}
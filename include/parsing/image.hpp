@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/action.hpp"
+#include "parsing/flagtable.hpp"
+#include "parsing/responsefile.hpp"
+
+
+namespace parsing {
+  // ParserImage declaration
+  //
+  // A built parser written out flat: fixed-size records for the groups, arguments and flag trie
+  // nodes, with every string in one pool and referred to by offset, so the file means the same
+  // wherever it's mapped. The header carries a format version, the record sizes (so an image from
+  // another build of the library is turned away rather than misread) and a fingerprint chosen
+  // by whoever wrote it, normally a hash of the code that defines the parser (see fnv1a), so a
+  // stale image is never loaded in place of a changed spec.
+  //
+  // Subcommand factories and stream() callbacks are code, so parsers with either can't be saved.
+  // A parser built over others (copies, parents) is saved as one, its groups merged by name.
+  struct ParserImage {
+    static constexpr std::array<char, 8> magic {'p', 'a', 'r', 's', 'i', 'n', 'g', '\0'};
+    static constexpr std::uint32_t format = 2;
+    static constexpr std::uint32_t none = UINT32_MAX;
+
+    struct Str {
+      std::uint32_t offset = 0;
+      std::uint32_t size = 0;
+    };
+
+    struct Header {
+      std::array<char, 8> magic;
+      std::uint32_t format;
+      std::uint32_t endian;
+      std::uint64_t fingerprint;
+      std::uint64_t size;
+      std::uint32_t header_size;
+      std::uint32_t group_size;
+      std::uint32_t action_size;
+      std::uint32_t node_size;
+      std::uint32_t group_count;
+      std::uint32_t action_count;
+      std::uint32_t flag_count;
+      std::uint32_t node_count;
+      // ParserCore::size, which runs ahead of action_count once help is removed
+      std::uint32_t next_index;
+      std::uint32_t reserved;
+      // Section offsets from the start of the file
+      std::uint64_t groups;
+      std::uint64_t actions;
+      std::uint64_t flags;
+      std::uint64_t nodes;
+      std::uint64_t keys;
+      std::uint64_t shorts;
+      std::uint64_t strings;
+      std::uint64_t strings_size;
+      Str name;
+      Str version;
+      Str usage;
+      Str description;
+      Str fromfile_prefix_chars;
+      std::uint8_t fromfile_mode;
+      std::uint8_t explicit_name;
+      std::uint8_t help_added;
+      std::uint8_t help_removed;
+      std::uint8_t allow_abbrev;
+      std::uint8_t numeric_flags;
+      std::uint8_t padding[2];
+    };
+
+    struct GroupRecord {
+      Str name;
+      std::uint32_t first_action;
+      std::uint32_t action_count;
+    };
+
+    struct ActionRecord {
+      Str flags_string;
+      Str dest;
+      Str metavar;
+      Str type;
+      Str default_value;
+      Str const_value;
+      Str help;
+      Str env;
+      std::uint64_t min_nargs;
+      std::uint64_t max_nargs;
+      std::uint32_t index;
+      std::uint32_t first_flag;
+      std::uint32_t flag_count;
+      std::uint8_t action;
+      std::uint8_t argtype;
+      std::uint8_t valuetype;
+      std::uint8_t required;
+      std::uint8_t nargs;
+      std::uint8_t padding[7];
+    };
+
+    struct NodeRecord {
+      Str label;
+      Str flag;
+      std::uint32_t first_child;
+      std::uint32_t child_count;
+      // ParserCore::index of the flag ending here and of the one action below, or `none`
+      std::uint32_t action;
+      std::uint32_t unique;
+    };
+
+    MappedFile file;
+    const Header* header = nullptr;
+
+    // Serializes `parser` (building its flag trie if it isn't compiled); false if it can't be
+    static auto write(const ArgumentParser& parser, std::uint64_t fingerprint, std::string& out) -> bool;
+    // Maps an image and checks it's one this build wrote for this fingerprint, and whole
+    auto open(const std::string& path, std::uint64_t fingerprint) -> bool;
+
+    auto str(Str value) const -> std::string_view;
+    auto groups() const -> const GroupRecord*;
+    auto actions() const -> const ActionRecord*;
+    auto flags() const -> const Str*;
+    // Fills `table` with views into the image; `by_index` maps ParserCore::index to the loaded actions
+    void restore(FlagTable& table, const std::vector<const Action*>& by_index) const;
+  private:
+    template <typename T>
+    auto _at(std::uint64_t offset) const -> const T*;
+  };
+}
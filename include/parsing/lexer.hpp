@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+
+
+namespace parsing {
+  // `value` is never produced by lex(); the parser marks positionals an optional consumed with it
+  enum struct tokenkinds: std::uint8_t {positional, optional, separator, value};
+
+  // Token declaration
+  //
+  // One classified argv entry. `eq` is the offset of the first '=' in an optional token, or
+  // npos; the flag and attached value are both views into `text`, nothing is copied.
+  struct Token {
+    std::string_view text;
+    std::uint32_t eq;
+    tokenkinds kind;
+
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    auto flag() const -> std::string_view;
+    auto value() const -> std::string_view;
+    auto has_value() const -> bool;
+  };
+
+  // Scans the arguments once, classifying each token and locating '=' in optionals.
+  // Everything after the first "--" is positional, and so is a lone "-". Like argparse, tokens
+  // that look like negative numbers are positional unless `numeric_flags` says some registered
+  // flag looks like one too (see FlagTable::numeric_flags).
+  auto lex(ArgSpan args, bool numeric_flags, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) -> std::pmr::vector<Token>;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/action.hpp"
+#include "parsing/actiongroup.hpp"
+#include "parsing/parsercore.hpp"
+#include "parsing/stats.hpp"
+
+
+namespace parsing {
+  // DestTable declaration
+  //
+  // Assigns every distinct dest one slot, in the order the dests were first registered.
+  // Actions sharing a dest share a slot; `action_slots` is indexed by ParserCore::index, which
+  // `layers` (each core the parser sees, with where its actions start) answers for the table.
+  // `envs` maps each environment variable named by Action::env to the actions reading it.
+  // `positionals` lays out the positional arguments once, in the order they take values, so a
+  // parse can hand values out in one pass without going back over the groups.
+  struct DestTable {
+    struct Positional {
+      const Action* action;
+      std::size_t slot;
+      nargstypes nargs;
+      std::size_t min;
+      // npos for '*' and '+'
+      std::size_t max;
+      // The values every positional before this one needs at least
+      std::size_t before;
+    };
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string_view, std::size_t> slots;
+    std::vector<std::size_t> action_slots;
+    std::vector<std::pair<const ParserCore*, std::size_t>> layers;
+    std::vector<std::pair<std::string, std::size_t>> env_actions;
+    std::unordered_multimap<std::string_view, std::size_t> envs;
+    std::vector<Positional> positionals;
+    // The values all of them need at least
+    std::size_t positional_min = 0;
+
+    void build(const ParserCore& core);
+    auto find(std::string_view dest) const -> std::size_t;
+    auto index(const Action& action) const -> std::size_t;
+    auto slot(const Action& action) const -> std::size_t;
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+  };
+
+  // Namespace declaration
+  //
+  // The result of a parse: one Result per dest, laid out contiguously and addressed by slot,
+  // by the Action that was returned from add_argument, or by dest name. Every value vector
+  // draws from one monotonic arena owned by the namespace, so a parse allocates a handful of
+  // times no matter how many values it collects. The arena gets its blocks from whichever
+  // memory resource the parse was given (see ArgumentParser::try_parse_args).
+  struct Namespace {
+    // Kept behind a pointer so moving a namespace never re-seats the arena under its vectors
+    struct Storage {
+#if PARSING_STATS
+      CountingResource counter;
+#endif
+      std::pmr::monotonic_buffer_resource arena;
+      std::pmr::vector<Result> slots;
+      std::pmr::vector<bool> provided;
+
+      Storage(std::size_t count, std::size_t capacity, std::pmr::memory_resource* upstream);
+
+      // Storage lives in the resource its arena draws from, and goes back there
+      struct Release {
+        std::pmr::memory_resource* resource = nullptr;
+        void operator()(Storage* storage) const;
+      };
+      static auto make(std::size_t count, std::size_t capacity, std::pmr::memory_resource* upstream) -> std::unique_ptr<Storage, Release>;
+    };
+
+    std::shared_ptr<const DestTable> layout;
+    std::unique_ptr<Storage, Storage::Release> storage;
+    // Whatever the values point into besides argv and the parser (mapped argument files, say)
+    std::vector<std::shared_ptr<void>> backing;
+    // The subcommand that was picked, if any, and what its parser made of the rest. Dests the
+    // parent doesn't know are looked up here, but Action handles from the subcommand's parser
+    // have to go through `subcommand` directly.
+    std::string_view command;
+    std::unique_ptr<Namespace> subcommand;
+
+    Namespace();
+    Namespace(std::shared_ptr<const DestTable> layout, std::size_t capacity, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    Namespace(const Namespace& other);
+    Namespace& operator=(const Namespace& other);
+    Namespace(Namespace&& other) noexcept = default;
+    Namespace& operator=(Namespace&& other) noexcept = default;
+
+    auto operator[](std::size_t slot) -> Result&;
+    auto operator[](std::size_t slot) const -> const Result&;
+    auto operator[](const Action& action) -> Result&;
+    auto operator[](const Action& action) const -> const Result&;
+    auto operator[](std::string_view dest) const -> const Result&;
+    auto at(std::string_view dest) const -> const Result&;
+    auto count(std::string_view dest) const -> std::size_t;
+    auto size() const -> std::size_t;
+
+    // Compatibility with code written against the map-returning parse_args
+    operator std::unordered_map<std::string, Result>() const;
+  };
+}
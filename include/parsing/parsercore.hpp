@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/action.hpp"
+#include "parsing/actiongroup.hpp"
+
+
+namespace parsing {
+  // ParserCore declaration
+  //
+  // The groups and actions a parser has been given, held apart from the rest of it so copies of
+  // the parser, and parsers naming it as a parent, can share them instead of copying them. A
+  // core is only ever changed while one parser holds it. A parser adding to a core that's
+  // shared starts a new, empty one layered over it instead (see ArgumentParser::writable), so
+  // copying or extending a parser costs the same however many arguments it has, and every
+  // Action it already had stays where it is.
+  struct ParserCore {
+    // The cores this one adds to, in order
+    std::pmr::vector<std::shared_ptr<const ParserCore>> parents;
+    std::pmr::deque<ActionGroup> groups;
+    // How many Action::index_ this core has handed out, not counting its parents'
+    std::size_t action_count = 0;
+    // Every core this one's parser sees, parents first and each only once, ending with this
+    // one; and where each one's actions start when all of them are counted together
+    std::pmr::vector<const ParserCore*> layers;
+    std::pmr::vector<std::size_t> offsets;
+    // Every layer's groups, in the same order
+    std::pmr::vector<const ActionGroup*> all_groups;
+    // The parser the groups point back at
+    ArgumentParser* owner = nullptr;
+    // False after load_image, until an add_argument needs the groups' duplicate-flag maps
+    bool flags_indexed = true;
+
+    explicit ParserCore(std::pmr::memory_resource* resource, const std::vector<std::shared_ptr<const ParserCore>>& parents = {});
+    // Layers are told apart by address
+    ParserCore(const ParserCore& other) = delete;
+    ParserCore& operator=(const ParserCore& other) = delete;
+
+    auto resource() const -> std::pmr::memory_resource*;
+    // Actions across every layer
+    auto size() const -> std::size_t;
+    // Where `action` comes when every layer's actions are counted together (so below size()), or
+    // npos if it's from none of them
+    auto index(const Action& action) const -> std::size_t;
+    // The action taking `flag` in the first `layer_count` layers (all of them by default), if any
+    auto find_flag(std::string_view flag, std::size_t layer_count = npos) const -> const Action*;
+    auto add_group(ArgumentParser& parser, std::string_view name) -> ActionGroup&;
+    // Points the groups back at `parser`, now holding this core
+    void adopt(ArgumentParser& parser);
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+  };
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/action.hpp"
+#include "parsing/namespace.hpp"
+#include "parsing/stats.hpp"
+
+
+namespace parsing {
+  enum struct outcomes: std::uint8_t {parsed, help, version, error};
+
+  // ParseError declaration
+  //
+  // What went wrong and where; `position` indexes the parsed arguments (so argv, for the argc/argv
+  // overloads), or is -1 when the error isn't tied to one token. Nothing is formatted until
+  // message() is called.
+  struct ParseError {
+    errors code {errors::none};
+    std::ptrdiff_t position = -1;
+    const Action* action = nullptr;
+    std::string_view token;
+    std::size_t count = 0;
+    std::vector<std::string_view> extra;
+
+    auto message() const -> std::string;
+  };
+
+  // ParseResult declaration
+  //
+  // What try_parse_args hands back instead of exiting: the namespace on success, or which of
+  // help, version or an error the command line asked for.
+  struct ParseResult {
+    outcomes outcome {outcomes::parsed};
+    Namespace values;
+    ParseError error;
+    // The subcommand parser that asked for help or version or failed, or null if it was this one
+    const ArgumentParser* parser = nullptr;
+#if PARSING_STATS
+    ParseStats stats {};
+#endif
+
+    explicit operator bool() const;
+  };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+
+
+namespace parsing {
+  // RecordReader declaration
+  //
+  // Reads delimited records (NUL by default, like xargs -0) from a file descriptor a fixed-size
+  // chunk at a time. Records that fit inside a chunk are handed over as views into it; only a
+  // record straddling two chunks is stitched together, so memory stays at one chunk plus the
+  // longest record. Empty records are skipped. `sink` returns false to stop early.
+  struct RecordReader {
+    int fd;
+    char delimiter = '\0';
+    std::size_t chunk = 64 * 1024;
+
+    // False only if reading failed; stopping early through `sink` still counts as success
+    auto each(const std::function<bool(std::string_view)>& sink) const -> bool;
+  };
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <forward_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "parsing/utils.hpp"
+#include "parsing/parseresult.hpp"
+#include "parsing/shell.hpp"
+
+
+namespace parsing {
+  enum struct rspmodes: std::uint8_t {newline, nul, shell};
+
+  // MappedFile declaration
+  //
+  // A read-only private mapping of a whole file; empty files map to an empty view.
+  struct MappedFile {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    auto open(const std::string& path) -> bool;
+    auto view() const -> std::string_view;
+  };
+
+  // ResponseFiles declaration
+  //
+  // Expands "@file" arguments (for whichever prefix characters the parser was given) into the
+  // arguments the file holds, recursively, failing on a file that includes itself. Files stay
+  // mapped for as long as this object lives, and expanded arguments are views into them; only
+  // shell-mode words that needed unescaping are copied, into `owned`.
+  //
+  // Expansion is eager: every argument of every file is tokenized into `out` before the parse
+  // starts, and lex() then builds a token for each. Nothing is copied out of the mapping, but
+  // memory still grows with the argument count, a view and a token (about 40 bytes) each, plus
+  // the value's slot in the namespace unless a stream() positional takes it.
+  struct ResponseFiles {
+    std::deque<MappedFile> files;
+    std::pmr::forward_list<std::pmr::string> owned;
+
+    auto expand(ArgSpan args, std::string_view prefix_chars, rspmodes mode, std::vector<std::string_view>& out, ParseError& error) -> bool;
+  private:
+    auto _expand_file(std::string_view path, std::string_view prefix_chars, rspmodes mode, std::vector<std::pair<std::uint64_t, std::uint64_t>>& stack, std::vector<std::string_view>& out, ParseError& error) -> bool;
+  };
+}
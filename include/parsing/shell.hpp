@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <forward_list>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+#include "parsing/utils.hpp"
+
+
+namespace parsing {
+  // ShellTokenizer declaration
+  //
+  // Splits text into words the way a POSIX shell would: whitespace separates words, single
+  // quotes are literal, double quotes honour \\ \" \$ \` and line continuations, a backslash
+  // outside quotes escapes the next character, and '#' at the start of a word comments out the
+  // rest of the line. With `expand` set, $NAME and ${NAME} outside single quotes are replaced by
+  // whatever it returns (results aren't split into further words, and an unquoted word that
+  // expands to nothing is dropped); without it '$' is an ordinary character.
+  //
+  // Words come back as views into `text` whenever they contain nothing to undo (including a
+  // word that is just one quoted span); only words with escapes, mixed quoting or expansions are
+  // rebuilt, into the caller's `owned` storage (and from its memory resource), which allocates
+  // nothing until it's used.
+  struct ShellTokenizer {
+    using expander = std::function<std::string(std::string_view name)>;
+
+    std::string_view text;
+    std::size_t pos = 0;
+    bool failed = false;
+    expander expand;
+
+    explicit ShellTokenizer(std::string_view text, expander expand = {});
+
+    auto next(std::string_view& token, std::pmr::forward_list<std::pmr::string>& owned) -> bool;
+  };
+}
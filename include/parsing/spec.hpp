@@ -0,0 +1,466 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "parsing/utils.hpp"
+
+
+// Compile-time parser specifications
+//
+// For small tools that know their whole command line up front:
+//
+//   constexpr auto cli = parsing::spec(
+//     parsing::flag<int>("--jobs", "-j", 1),
+//     parsing::flag<bool>("--verbose", "-v"),
+//     parsing::positional<std::string_view, parsing::nargstypes::plus>("src")
+//   );
+//   auto parsed = cli.parse(argc, argv);
+//   if (parsed) { int jobs = parsed.get<0>(); ... }
+//
+// The spec is validated while it is being constant-evaluated, so duplicate flags, malformed
+// names and ambiguous positional layouts fail the build instead of exiting at runtime. The flag
+// table is sorted at compile time too, and parse() never touches the heap: values are either
+// converted in place or are views into argv.
+namespace parsing {
+  // A contiguous run of argv collected by a variadic positional
+  struct argv_range {
+    const char* const* first = nullptr;
+    const char* const* last = nullptr;
+
+    auto begin() const -> const char* const* { return first; }
+    auto end() const -> const char* const* { return last; }
+    auto size() const -> std::size_t { return static_cast<std::size_t>(last - first); }
+    auto empty() const -> bool { return first == last; }
+    auto operator[](std::size_t ix) const -> std::string_view { return first[ix]; }
+  };
+
+  template <typename T>
+  struct flag {
+    static_assert(std::is_arithmetic_v<T> or std::is_same_v<T, std::string_view>, "flag values must be bool, an integer, a floating point type, or std::string_view");
+
+    using value_type = T;
+    static constexpr bool is_flag = true;
+
+    std::string_view name;
+    std::string_view alias;
+    T default_value;
+
+    constexpr explicit flag(std::string_view name, std::string_view alias = {}, T default_value = T{})
+      : name(name), alias(alias), default_value(default_value) {}
+  };
+
+  template <typename T, nargstypes N = nargstypes::exact>
+  struct positional {
+    static_assert(std::is_arithmetic_v<T> or std::is_same_v<T, std::string_view>, "positional values must be an integer, a floating point type, or std::string_view");
+    static_assert(not std::is_same_v<T, bool>, "positionals cannot be bool; use flag<bool> instead");
+    static_assert(N == nargstypes::exact or N == nargstypes::optional or std::is_same_v<T, std::string_view>, "variadic positionals collect std::string_view");
+
+    using value_type = std::conditional_t<N == nargstypes::exact, T, std::conditional_t<N == nargstypes::optional, std::optional<T>, argv_range>>;
+    static constexpr bool is_flag = false;
+    static constexpr nargstypes nargs = N;
+
+    std::string_view name;
+
+    constexpr explicit positional(std::string_view name) : name(name) {}
+  };
+
+  template <typename Values>
+  struct SpecResult {
+    Values values;
+    errors error = errors::none;
+    int position = -1;
+
+    explicit operator bool() const { return error == errors::none; }
+
+    template <std::size_t I>
+    auto get() const -> const std::tuple_element_t<I, Values>& { return std::get<I>(values); }
+  };
+
+  template <typename Item>
+  constexpr auto positional_nargs() -> nargstypes {
+    if constexpr (Item::is_flag) {
+      return nargstypes::exact;
+    }
+    else {
+      return Item::nargs;
+    }
+  }
+
+  // Spec declaration
+  template <typename... Items>
+  struct Spec {
+    using values_type = std::tuple<typename Items::value_type...>;
+
+    struct Entry {
+      std::string_view name;
+      std::size_t item = 0;
+    };
+
+    static constexpr std::size_t table_size = 2 * (std::size_t(0) + ... + std::size_t(Items::is_flag));
+    static constexpr std::size_t variable_count = (std::size_t(0) + ... + std::size_t(not Items::is_flag and positional_nargs<Items>() != nargstypes::exact));
+    static_assert(variable_count <= 1, "at most one positional may use nargs '?', '*' or '+'");
+
+    std::tuple<Items...> items;
+    std::array<Entry, table_size> table {};
+    std::size_t table_begin = 0;
+
+    constexpr explicit Spec(Items... values) : items(values...) {
+      std::size_t count = 0;
+      register_all(count, std::index_sequence_for<Items...>{});
+      sort_table();
+      check_table();
+    }
+
+    auto parse(int argc, const char* const* argv) const -> SpecResult<values_type> {
+      return parse_impl(argc, argv, std::index_sequence_for<Items...>{});
+    }
+
+    constexpr auto find(std::string_view name) const -> std::size_t {
+      std::size_t low = table_begin;
+      std::size_t high = table_size;
+      while (low < high) {
+        std::size_t mid = low + (high - low) / 2;
+        if (less(table[mid].name, name)) {
+          low = mid + 1;
+        }
+        else {
+          high = mid;
+        }
+      }
+      if (low < table_size and table[low].name == name) {
+        return table[low].item;
+      }
+      return sizeof...(Items);
+    }
+
+  private:
+    static constexpr auto less(std::string_view left, std::string_view right) -> bool {
+      return left.size() != right.size() ? left.size() < right.size() : left < right;
+    }
+
+    template <std::size_t... I>
+    constexpr void register_all(std::size_t& count, std::index_sequence<I...>) {
+      (register_item<I>(count), ...);
+    }
+
+    template <std::size_t I>
+    constexpr void register_item(std::size_t& count) {
+      const auto& item = std::get<I>(items);
+      if constexpr (std::tuple_element_t<I, std::tuple<Items...>>::is_flag) {
+        if (item.name.size() < 2 or item.name.front() != '-' or item.name == "--") {
+          throw std::invalid_argument("flag names must start with a hyphen");
+        }
+        if (not item.alias.empty() and (item.alias.size() < 2 or item.alias.front() != '-' or item.alias == "--")) {
+          throw std::invalid_argument("flag aliases must start with a hyphen");
+        }
+        if (item.name.find('=') != item.name.npos or item.alias.find('=') != item.alias.npos) {
+          throw std::invalid_argument("flag names cannot contain '='");
+        }
+        table[count++] = Entry{item.name, I};
+        table[count++] = Entry{item.alias, I};
+      }
+      else {
+        if (item.name.empty() or item.name.front() == '-') {
+          throw std::invalid_argument("positional names cannot be empty or start with a hyphen");
+        }
+      }
+    }
+
+    constexpr void sort_table() {
+      for (std::size_t ix = 1; ix < table_size; ++ix) {
+        Entry entry = table[ix];
+        std::size_t jx = ix;
+        for (; jx > 0 and less(entry.name, table[jx - 1].name); --jx) {
+          table[jx] = table[jx - 1];
+        }
+        table[jx] = entry;
+      }
+      // Missing aliases are empty and sort first; skip past them
+      while (table_begin < table_size and table[table_begin].name.empty()) {
+        ++table_begin;
+      }
+    }
+
+    constexpr void check_table() const {
+      for (std::size_t ix = table_begin + 1; ix < table_size; ++ix) {
+        if (table[ix].name == table[ix - 1].name) {
+          throw std::invalid_argument("duplicate flag in parser specification");
+        }
+      }
+    }
+
+    template <typename T>
+    static auto convert_to(std::string_view text, T& out) -> bool {
+      Value value{};
+      if constexpr (std::is_same_v<T, std::string_view>) {
+        out = text;
+        return true;
+      }
+      else if constexpr (std::is_same_v<T, bool>) {
+        if (not convert(valuetypes::boolean, text, value)) {
+          return false;
+        }
+        out = value.u != 0;
+        return true;
+      }
+      else if constexpr (std::is_floating_point_v<T>) {
+        if (not convert(valuetypes::float64, text, value)) {
+          return false;
+        }
+        out = static_cast<T>(value.f);
+        return true;
+      }
+      else if constexpr (std::is_signed_v<T>) {
+        if (not convert(valuetypes::int64, text, value) or value.i < std::numeric_limits<T>::min() or value.i > std::numeric_limits<T>::max()) {
+          return false;
+        }
+        out = static_cast<T>(value.i);
+        return true;
+      }
+      else {
+        if (not convert(valuetypes::uint64, text, value) or value.u > std::numeric_limits<T>::max()) {
+          return false;
+        }
+        out = static_cast<T>(value.u);
+        return true;
+      }
+    }
+
+    template <std::size_t... I>
+    auto defaults(std::index_sequence<I...>) const -> values_type {
+      return values_type(default_of<I>()...);
+    }
+
+    template <std::size_t I>
+    auto default_of() const -> std::tuple_element_t<I, values_type> {
+      if constexpr (std::tuple_element_t<I, std::tuple<Items...>>::is_flag) {
+        return std::get<I>(items).default_value;
+      }
+      else {
+        return {};
+      }
+    }
+
+    // Stores a flag occurrence into tuple slot I; `next` is the following argv entry, if any
+    template <std::size_t I>
+    auto store_flag(values_type& values, std::string_view attached, bool has_attached, const char* next, int& consumed) const -> errors {
+      using T = typename std::tuple_element_t<I, std::tuple<Items...>>::value_type;
+      if constexpr (std::is_same_v<T, bool>) {
+        if (has_attached) {
+          return errors::unexpected_value;
+        }
+        std::get<I>(values) = not std::get<I>(items).default_value;
+        return errors::none;
+      }
+      else {
+        if (not has_attached) {
+          if (next == nullptr) {
+            return errors::missing_value;
+          }
+          attached = next;
+          consumed = 1;
+        }
+        return convert_to(attached, std::get<I>(values)) ? errors::none : errors::invalid_value;
+      }
+    }
+
+    template <std::size_t... I>
+    auto dispatch_flag(std::size_t item, values_type& values, std::string_view attached, bool has_attached, const char* next, int& consumed, std::index_sequence<I...>) const -> errors {
+      errors status = errors::none;
+      (void)((item == I and (status = store_flag_if_flag<I>(values, attached, has_attached, next, consumed), true)) or ...);
+      return status;
+    }
+
+    template <std::size_t I>
+    auto store_flag_if_flag(values_type& values, std::string_view attached, bool has_attached, const char* next, int& consumed) const -> errors {
+      if constexpr (std::tuple_element_t<I, std::tuple<Items...>>::is_flag) {
+        return store_flag<I>(values, attached, has_attached, next, consumed);
+      }
+      else {
+        return errors::unrecognized_optional;
+      }
+    }
+
+    template <std::size_t... I>
+    auto takes_value(std::size_t item, std::index_sequence<I...>) const -> bool {
+      bool value = false;
+      (void)((item == I and (value = not std::is_same_v<typename std::tuple_element_t<I, std::tuple<Items...>>::value_type, bool>, true)) or ...);
+      return value;
+    }
+
+    template <std::size_t I>
+    auto quota_of(std::size_t spare) const -> std::size_t {
+      using Item = std::tuple_element_t<I, std::tuple<Items...>>;
+      if constexpr (Item::is_flag) {
+        return 0;
+      }
+      else if constexpr (Item::nargs == nargstypes::exact) {
+        return 1;
+      }
+      else if constexpr (Item::nargs == nargstypes::optional) {
+        return spare > 0 ? 1 : 0;
+      }
+      else {
+        return spare;
+      }
+    }
+
+    // Stores one positional token into tuple slot I
+    template <std::size_t I>
+    auto store_positional(values_type& values, const char* const* argv, int ix) const -> errors {
+      using Item = std::tuple_element_t<I, std::tuple<Items...>>;
+      if constexpr (Item::is_flag) {
+        return errors::unrecognized_positional;
+      }
+      else if constexpr (Item::nargs == nargstypes::exact) {
+        return convert_to(argv[ix], std::get<I>(values)) ? errors::none : errors::invalid_value;
+      }
+      else if constexpr (Item::nargs == nargstypes::optional) {
+        typename Item::value_type::value_type value{};
+        if (not convert_to(argv[ix], value)) {
+          return errors::invalid_value;
+        }
+        std::get<I>(values) = value;
+        return errors::none;
+      }
+      else {
+        // Variadics are views into argv, so their tokens have to sit next to each other
+        auto& range = std::get<I>(values);
+        if (range.first == nullptr) {
+          range = argv_range{argv + ix, argv + ix + 1};
+          return errors::none;
+        }
+        if (range.last != argv + ix) {
+          return errors::interleaved_positionals;
+        }
+        ++range.last;
+        return errors::none;
+      }
+    }
+
+    template <std::size_t... I>
+    auto dispatch_positional(std::size_t item, values_type& values, const char* const* argv, int ix, std::index_sequence<I...>) const -> errors {
+      errors status = errors::none;
+      (void)((item == I and (status = store_positional<I>(values, argv, ix), true)) or ...);
+      return status;
+    }
+
+    // Where a flag token's item is, and whether it swallows the next argv entry
+    auto classify(std::string_view arg, std::size_t& item, std::string_view& attached, bool& has_attached) const -> void {
+      item = find(arg);
+      has_attached = false;
+      if (item == sizeof...(Items)) {
+        auto eq = arg.find('=');
+        if (eq != arg.npos) {
+          item = find(arg.substr(0, eq));
+          attached = arg.substr(eq + 1);
+          has_attached = true;
+        }
+      }
+    }
+
+    // Two walks over argv and nothing else: the first handles flags and counts positionals, the
+    // second hands positionals out in declaration order, the one variable slot taking the spare.
+    template <std::size_t... I>
+    auto parse_impl(int argc, const char* const* argv, std::index_sequence<I...> sequence) const -> SpecResult<values_type> {
+      SpecResult<values_type> result{defaults(sequence)};
+      std::array<bool, sizeof...(Items)> seen {};
+
+      constexpr std::size_t exact = (std::size_t(0) + ... + std::size_t(not Items::is_flag and positional_nargs<Items>() == nargstypes::exact));
+      constexpr bool plus = (false or ... or (not Items::is_flag and positional_nargs<Items>() == nargstypes::plus));
+      constexpr bool single = (false or ... or (not Items::is_flag and positional_nargs<Items>() == nargstypes::optional));
+
+      auto fail = [&](errors error, int position){
+        result.error = error;
+        result.position = position;
+        return result;
+      };
+
+      std::size_t count = 0;
+      int last_positional = -1;
+      bool only_positionals = false;
+      for (int ix = 1; ix < argc; ++ix) {
+        std::string_view arg = argv[ix];
+        if (only_positionals or arg.size() < 2 or arg.front() != '-') {
+          last_positional = ix;
+          ++count;
+          continue;
+        }
+        if (arg == "--") {
+          only_positionals = true;
+          continue;
+        }
+
+        std::size_t item = 0;
+        std::string_view attached;
+        bool has_attached = false;
+        classify(arg, item, attached, has_attached);
+        if (item == sizeof...(Items)) {
+          return fail(errors::unrecognized_optional, ix);
+        }
+        if (seen[item]) {
+          return fail(errors::already_provided, ix);
+        }
+        seen[item] = true;
+
+        int consumed = 0;
+        auto status = dispatch_flag(item, result.values, attached, has_attached, ix + 1 < argc ? argv[ix + 1] : nullptr, consumed, sequence);
+        if (status != errors::none) {
+          return fail(status, ix);
+        }
+        ix += consumed;
+      }
+
+      if (count < exact + (plus ? 1 : 0)) {
+        return fail(errors::missing_positional, argc);
+      }
+      if ((variable_count == 0 and count > exact) or (single and count > exact + 1)) {
+        return fail(errors::unrecognized_positional, last_positional);
+      }
+
+      std::size_t spare = count - exact;
+      std::array<std::size_t, sizeof...(Items)> quota {quota_of<I>(spare)...};
+      std::size_t item = 0;
+      only_positionals = false;
+      for (int ix = 1; ix <= last_positional; ++ix) {
+        std::string_view arg = argv[ix];
+        if (not only_positionals and arg.size() > 1 and arg.front() == '-') {
+          if (arg == "--") {
+            only_positionals = true;
+            continue;
+          }
+          std::size_t flag_item = 0;
+          std::string_view attached;
+          bool has_attached = false;
+          classify(arg, flag_item, attached, has_attached);
+          if (not has_attached and takes_value(flag_item, sequence)) {
+            ++ix;
+          }
+          continue;
+        }
+        while (quota[item] == 0) {
+          ++item;
+        }
+        auto status = dispatch_positional(item, result.values, argv, ix, sequence);
+        if (status != errors::none) {
+          return fail(status, ix);
+        }
+        --quota[item];
+      }
+      return result;
+    }
+  };
+
+  template <typename... Items>
+  constexpr auto spec(Items... items) -> Spec<Items...> {
+    return Spec<Items...>(items...);
+  }
+}
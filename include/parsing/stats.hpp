@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+
+// Build with PARSING_STATS=1 (the CMake option of the same name sets it for the library and
+// everything linking it) to have every ParseResult carry a ParseStats. Without it none of this
+// exists, and the hooks in the parser compile to nothing.
+#ifndef PARSING_STATS
+#define PARSING_STATS 0
+#endif
+
+#if PARSING_STATS
+#define PARSING_STATS_ENTER(parsed, phase) (parsed).stats.enter(::parsing::ParseStats::phases::phase)
+#define PARSING_STATS_ADD(parsed, counter, amount) ((parsed).stats.counter += (amount))
+#define PARSING_STATS_FINISH(parsed) (parsed).stats.finish((parsed).values.storage->counter)
+#else
+#define PARSING_STATS_ENTER(parsed, phase) ((void)0)
+#define PARSING_STATS_ADD(parsed, counter, amount) ((void)0)
+#define PARSING_STATS_FINISH(parsed) ((void)0)
+#endif
+
+
+namespace parsing {
+  inline constexpr bool stats_enabled = PARSING_STATS;
+
+#if PARSING_STATS
+  // CountingResource declaration
+  //
+  // Passes everything on to `upstream`, counting what it asks for on the way.
+  struct CountingResource : std::pmr::memory_resource {
+    std::pmr::memory_resource* upstream;
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+
+    explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) : upstream(upstream) {}
+  private:
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override;
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+    auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override;
+  };
+
+  // ParseStats declaration
+  //
+  // What one parse did and where its time went. Phases follow the parser's own passes; each is
+  // timed from when it's entered until the next one is, so they add up to the whole parse. The
+  // allocation counters cover the namespace's arena, which is where a parse allocates.
+  struct ParseStats {
+    enum struct phases: std::uint8_t {expand, lex, optionals, environment, defaults, required, positionals, convert, stream, subcommand};
+    static constexpr std::size_t phase_count = 10;
+
+    struct Span {
+      phases phase;
+      std::uint64_t start_ns;
+      std::uint64_t duration_ns;
+    };
+
+    std::size_t tokens = 0;
+    std::size_t lookups = 0;
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+    // Indexed by phase
+    std::array<std::uint64_t, phase_count> phase_ns {};
+    // In the order they ran, for chrome_trace; a parse never has more than one of each
+    std::array<Span, phase_count> spans {};
+    std::size_t span_count = 0;
+    // A small number per thread, to lay out parse_batch runs side by side in a trace
+    std::uint32_t thread = current_thread();
+    bool open = false;
+    phases current {phases::lex};
+    std::uint64_t started = 0;
+
+    static auto now() -> std::uint64_t;
+    static auto current_thread() -> std::uint32_t;
+
+    void enter(phases phase);
+    void record(phases phase, std::uint64_t start_ns, std::uint64_t end_ns);
+    void finish(const CountingResource& counter);
+    auto total_ns() const -> std::uint64_t;
+    // This parse as Chrome trace JSON (chrome://tracing, Perfetto)
+    auto chrome_trace() const -> std::string;
+  };
+
+  inline constexpr std::array<std::string_view, ParseStats::phase_count> phase_names {"expand", "lex", "optionals", "environment", "defaults", "required", "positionals", "convert", "stream", "subcommand"};
+
+  constexpr auto name_of(ParseStats::phases value) -> std::string_view {
+    return phase_names[static_cast<std::size_t>(value)];
+  }
+
+  // Several parses in one trace, each on its thread's row
+  auto chrome_trace(const std::vector<const ParseStats*>& runs) -> std::string;
+#endif
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parsing/utils.hpp"
+
+
+namespace parsing {
+  // Subparsers declaration
+  //
+  // The subcommands of a parser. Each one is only a name, a help line and a factory until it's
+  // picked on the command line; then a fresh parser named "<parent> <command>" is created, the
+  // factory fills it in, and it parses everything after the command name. So startup doesn't
+  // depend on what options the subcommands define, and registering each one costs the same: it's
+  // appended, with literal names and help kept as views (and a captureless factory allocating
+  // nothing), and only compile() sorts them. Duplicate names are reported there too.
+  struct Subparsers {
+    using factory = std::function<void(ArgumentParser&)>;
+
+    struct Entry {
+      std::string_view name;
+      std::string_view help;
+      factory build;
+    };
+
+    std::string title = "Commands";
+    bool required = true;
+    // In the order they were added, which is how help lists them. Once indexed, `order` sorts
+    // them by name so dispatch is a binary search; until then (or after more are added) it's a
+    // scan. Names and help that weren't literals are copied into `text`, which copies share
+    // since it's only ever appended to.
+    std::vector<Entry> entries;
+    std::vector<std::uint32_t> order;
+    std::shared_ptr<std::deque<std::string>> text;
+
+    auto add_parser(const std::string& name, factory build, const std::string& help = "") -> Subparsers&;
+    template <std::size_t N>
+    auto add_parser(const char (&name)[N], factory build) -> Subparsers& { return _add(name, std::move(build), {}); }
+    template <std::size_t N, std::size_t M>
+    auto add_parser(const char (&name)[N], factory build, const char (&help)[M]) -> Subparsers& { return _add(name, std::move(build), help); }
+    void index();
+    auto find(std::string_view name) const -> const Entry*;
+  private:
+    auto _add(std::string_view name, factory build, std::string_view help) -> Subparsers&;
+  };
+}
@@ -1,13 +1,19 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <chrono>
 #include <cstdint>
 #include <deque>
 #include <iomanip>
 #include <iostream>
 #include <locale>
+#include <memory_resource>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -17,12 +23,17 @@ namespace parsing {
 
   struct Action;
   struct ActionGroup;
+  struct ParserCore;
   struct ArgumentParser;
+  struct Result;
 
-  extern std::locale default_locale;
+  // The user's locale, only created the first time it's asked for (and the classic one if the
+  // environment names a locale that doesn't exist)
+  auto default_locale() -> const std::locale&;
 
-  extern std::unordered_map<std::size_t, std::string> level_colors;
-  extern std::unordered_map<std::size_t, std::string> level_names;
+  // Indexed by level / 10
+  inline constexpr std::array<std::string_view, 6> level_colors {"\x1b[00m", "\x1b[36m", "\x1b[32m", "\x1b[33m", "\x1b[31m", "\x1b[41m"};
+  inline constexpr std::array<std::string_view, 6> level_names {"", "debug", "info", "warning", "error", "critical"};
 
   void log(std::size_t level, const std::string& name, const std::string& msg);
   void critical(const std::string& name, const std::string& msg);
@@ -33,9 +44,48 @@ namespace parsing {
 
   enum struct actions: std::uint8_t {store, store_true, store_false, store_const, append_const, append, extend, count, help, version};
   enum struct argtypes: std::uint8_t {positional, optional, boolean};
+  enum struct valuetypes: std::uint8_t {string, int64, uint64, float64, boolean, size, duration};
+  enum struct nargstypes: std::uint8_t {exact, optional, any, plus};
+  enum struct errors: std::uint8_t {none, unrecognized_optional, already_provided, missing_value, unexpected_value, invalid_value, missing_positional, unrecognized_positional, interleaved_positionals, ambiguous_value, missing_required, unsupported_action, unreadable_file, recursive_file, malformed_file, unreadable_input, malformed_line, missing_command, unknown_command, ambiguous_option, unreadable_config, malformed_config, unknown_key};
 
-  extern std::unordered_map<actions, std::string> action_mapping;
-  extern std::unordered_map<argtypes, std::string> argtype_mapping;
+  // Indexed by the enums above; constant data, so nothing runs before main and any thread can read them
+  inline constexpr std::array<std::string_view, 10> action_names {"store", "store_true", "store_false", "store_const", "append_const", "append", "extend", "count", "help", "version"};
+  inline constexpr std::array<std::string_view, 3> argtype_names {"positional", "optional", "boolean"};
+  inline constexpr std::array<std::string_view, 7> valuetype_names {"string", "int64", "uint64", "double", "bool", "size", "duration"};
+  // As nargs() spells them, a count standing for exact
+  inline constexpr std::array<std::string_view, 4> nargstype_names {"N", "?", "*", "+"};
+
+  constexpr auto name_of(actions value) -> std::string_view {
+    return action_names[static_cast<std::size_t>(value)];
+  }
+
+  constexpr auto name_of(argtypes value) -> std::string_view {
+    return argtype_names[static_cast<std::size_t>(value)];
+  }
+
+  constexpr auto name_of(valuetypes value) -> std::string_view {
+    return valuetype_names[static_cast<std::size_t>(value)];
+  }
+
+  constexpr auto name_of(nargstypes value) -> std::string_view {
+    return nargstype_names[static_cast<std::size_t>(value)];
+  }
+
+  // 64-bit FNV-1a; constexpr, so a fingerprint of a spec's text can be worked out at compile time
+  constexpr auto fnv1a(std::string_view text, std::uint64_t hash = 14695981039346656037ull) -> std::uint64_t {
+    for (char c : text) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  // A converted value; which member is live depends on the valuetype it was converted with.
+  // size is stored in bytes and duration in nanoseconds, both in `u` and `i` respectively.
+  union Value {
+    std::int64_t i;
+    std::uint64_t u;
+    double f;
+  };
 
   auto repr(int value) -> std::string;
   auto repr(std::size_t value) -> std::string;
@@ -44,19 +94,102 @@ namespace parsing {
   auto reprjoin(const std::string& separator, const std::vector<std::string>& values) -> std::string;
   auto reprjoin(const std::string& separator, const std::deque<std::string>& values) -> std::string;
 
-  auto is_number(const std::string& value) -> bool;
+  auto is_number(std::string_view value) -> bool;
   auto sorted_by_size(const std::vector<std::string>& values) -> std::vector<std::string>;
   auto to_upper(const std::string& value) -> std::string;
   auto get_dest(const std::vector<std::string>& values) -> std::string;
   auto get_argtype(const std::vector<std::string>& values) -> argtypes;
   auto get_required(const std::vector<std::string>& values) -> bool;
+  auto get_valuetype(const std::string& value, valuetypes& out) -> bool;
+  auto convert(valuetypes type, std::string_view text, Value& out) -> bool;
+
+  // ArgSpan declaration
+  //
+  // The arguments of one parse, wherever they're stored: a std::vector, a std::pmr::vector in the
+  // caller's memory resource, or a stretch of either.
+  struct ArgSpan {
+    const std::string_view* first = nullptr;
+    std::size_t count = 0;
+
+    ArgSpan() = default;
+    ArgSpan(const std::string_view* first, std::size_t count) : first(first), count(count) {}
+    template <typename Allocator>
+    ArgSpan(const std::vector<std::string_view, Allocator>& args) : first(args.data()), count(args.size()) {}
+
+    auto begin() const -> const std::string_view* { return first; }
+    auto end() const -> const std::string_view* { return first + count; }
+    auto size() const -> std::size_t { return count; }
+    auto empty() const -> bool { return count == 0; }
+    auto operator[](std::size_t ix) const -> std::string_view { return first[ix]; }
+  };
+
+  // Occurrence declaration
+  //
+  // The values one use of an option gave, as a view into Result::values; `offset` is where they
+  // start there (and in Result::typed, once converted).
+  struct Occurrence {
+    const std::string_view* first = nullptr;
+    const std::string_view* last = nullptr;
+    std::size_t offset = 0;
+
+    auto begin() const -> const std::string_view* { return first; }
+    auto end() const -> const std::string_view* { return last; }
+    auto size() const -> std::size_t { return static_cast<std::size_t>(last - first); }
+    auto empty() const -> bool { return first == last; }
+    auto operator[](std::size_t ix) const -> std::string_view { return first[ix]; }
+  };
+
+  // Occurrences declaration
+  //
+  // Every occurrence in a Result, in command-line order, for range-for
+  struct Occurrences {
+    struct iterator {
+      const Result* result;
+      std::size_t ix;
+
+      auto operator*() const -> Occurrence;
+      auto operator++() -> iterator& { ++ix; return *this; }
+      auto operator==(const iterator& other) const -> bool { return ix == other.ix; }
+      auto operator!=(const iterator& other) const -> bool { return ix != other.ix; }
+    };
+
+    const Result* result;
+
+    auto begin() const -> iterator;
+    auto end() const -> iterator;
+    auto size() const -> std::size_t;
+    auto operator[](std::size_t ix) const -> Occurrence;
+  };
 
   // Result declaration
+  //
+  // Values are views into whatever was parsed (argv, the caller's strings, or the parser itself);
+  // a std::string is only built when one of the string accessors asks for it. Arguments with a
+  // non-string type are converted once during the parse and cached in `typed`.
+  //
+  // An append option keeps every use's values in the one flat `values`, with `starts` saying
+  // where each use begins, so however often it's given that's two growing arrays rather than a
+  // vector per use. Anything else counts as a single occurrence of all its values.
   struct Result {
-    std::vector<std::string> values;
+    using allocator_type = std::pmr::polymorphic_allocator<std::string_view>;
+
+    std::pmr::vector<std::string_view> values;
+    std::pmr::vector<Value> typed;
+    std::pmr::vector<std::size_t> starts;
+    valuetypes type {valuetypes::string};
+
+    Result() = default;
+    explicit Result(const allocator_type& alloc);
+    Result(const Result& other, const allocator_type& alloc);
+    Result(const Result& other) = default;
+    Result(Result&& other) = default;
+    Result& operator=(const Result& other) = default;
+    Result& operator=(Result&& other) = default;
 
-    void append(const std::string& value);
-    void prepend(const std::string& value);
+    void append(std::string_view value);
+    void prepend(std::string_view value);
+    // Starts a new occurrence; the values appended after it belong to it
+    void begin_occurrence();
     auto size() -> std::size_t;
     auto empty() -> bool;
     void clear();
@@ -74,6 +207,15 @@ namespace parsing {
     auto as_size_t() const -> std::size_t;
     auto as_string() const -> std::string;
     auto as_strings() const -> std::vector<std::string>;
+    auto as_view() const -> std::string_view;
+    auto as_views() const -> const std::pmr::vector<std::string_view>&;
+    auto occurrences() const -> Occurrences;
+    auto occurrence(std::size_t ix) const -> Occurrence;
+    auto occurrence_count() const -> std::size_t;
     auto as_ints() const -> std::vector<int>;
+    auto as_int64() const -> std::int64_t;
+    auto as_uint64() const -> std::uint64_t;
+    auto as_double() const -> double;
+    auto as_duration() const -> std::chrono::nanoseconds;
   };
 }
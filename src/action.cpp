@@ -1,21 +1,90 @@
 #include "parsing/action.hpp"
 
 
+namespace {
+  // The setters that may only be called once, by their bit in Action::user_provided
+  constexpr std::array<std::string_view, 12> once_methods {"dest", "nargs", "action", "default_value", "const_value", "type", "metavar", "help", "required", "stream", "stream_stdin", "env"};
+}
+
+
 // Action definition
-parsing::Action::Action(const std::string& value) : Action({value}) {}
-
-parsing::Action::Action(const std::initializer_list<std::string>& values)
-  : flags_(values)
-  , flags_string_(join("/", sorted_by_size(values)))
-  , required_(get_required(values))
-  , dest_(get_dest(values))
-  , metavar_(to_upper(get_dest(values)))
-  , argtype_(get_argtype(values))
-{
+parsing::Action::Action(const allocator_type& alloc)
+  : flags_(alloc)
+  , flags_string_(alloc)
+  , dest_(alloc)
+  , metavar_(alloc)
+  , type_("string", alloc)
+  , default_(alloc)
+  , const_(alloc)
+  , help_(alloc)
+  , env_(alloc)
+{}
+
+parsing::Action::Action(const std::string& value, const allocator_type& alloc) : Action({value}, alloc) {}
+
+parsing::Action::Action(const std::initializer_list<std::string>& values, const allocator_type& alloc) : Action(alloc) {
   if (values.size() == 0) {
     error("Action", "must have at least one option string");
     std::quick_exit(1);
   }
+  flags_.assign(values.begin(), values.end());
+  flags_string_ = join("/", sorted_by_size(values));
+  required_ = get_required(values);
+  dest_ = get_dest(values);
+  metavar_ = to_upper(get_dest(values));
+  argtype_ = get_argtype(values);
+}
+
+parsing::Action::Action(const Action& other, const allocator_type& alloc)
+  : flags_(other.flags_, alloc)
+  , flags_string_(other.flags_string_, alloc)
+  , required_(other.required_)
+  , dest_(other.dest_, alloc)
+  , metavar_(other.metavar_, alloc)
+  , argtype_(other.argtype_)
+  , type_(other.type_, alloc)
+  , valuetype_(other.valuetype_)
+  , default_(other.default_, alloc)
+  , const_(other.const_, alloc)
+  , nargs_(other.nargs_)
+  , action_(other.action_)
+  , min_nargs_(other.min_nargs_)
+  , max_nargs_(other.max_nargs_)
+  , user_provided(other.user_provided)
+  , help_(other.help_, alloc)
+  , index_(other.index_)
+  , core_(other.core_)
+  , stream_(other.stream_)
+  , stream_stdin_(other.stream_stdin_)
+  , env_(other.env_, alloc)
+{}
+
+parsing::Action::Action(Action&& other, const allocator_type& alloc)
+  : flags_(std::move(other.flags_), alloc)
+  , flags_string_(std::move(other.flags_string_), alloc)
+  , required_(other.required_)
+  , dest_(std::move(other.dest_), alloc)
+  , metavar_(std::move(other.metavar_), alloc)
+  , argtype_(other.argtype_)
+  , type_(std::move(other.type_), alloc)
+  , valuetype_(other.valuetype_)
+  , default_(std::move(other.default_), alloc)
+  , const_(std::move(other.const_), alloc)
+  , nargs_(other.nargs_)
+  , action_(other.action_)
+  , min_nargs_(other.min_nargs_)
+  , max_nargs_(other.max_nargs_)
+  , user_provided(other.user_provided)
+  , help_(std::move(other.help_), alloc)
+  , index_(other.index_)
+  , core_(other.core_)
+  , stream_(std::move(other.stream_))
+  , stream_stdin_(other.stream_stdin_)
+  , env_(std::move(other.env_), alloc)
+{}
+
+auto parsing::Action::get_allocator() const -> allocator_type {
+  return dest_.get_allocator();
 }
 
 // Convenience via method chaining
@@ -32,14 +101,17 @@ auto parsing::Action::dest(const std::string& value) -> parsing::Action& {
 auto parsing::Action::nargs(const std::string& value) -> parsing::Action& {
   _check("nargs");
   if (value == "?") {
+    nargs_ = nargstypes::optional;
     min_nargs_ = 0;
     max_nargs_ = 1;
   }
   else if (value == "*") {
+    nargs_ = nargstypes::any;
     min_nargs_ = 0;
     max_nargs_ = 0;
   }
   else if (value == "+") {
+    nargs_ = nargstypes::plus;
     min_nargs_ = 1;
     max_nargs_ = 0;
   }
@@ -47,21 +119,24 @@ auto parsing::Action::nargs(const std::string& value) -> parsing::Action& {
     error("Action", "nargs must be either a positive integer or one of: '?', '*', '+'");
     std::quick_exit(1);
   }
-  nargs_ = value;
   return *this;
 }
 
 auto parsing::Action::nargs(std::size_t value) -> parsing::Action& {
   _check("nargs");
+  nargs_ = nargstypes::exact;
   min_nargs_ = value;
   max_nargs_ = value;
-  action_ = actions::extend;
+  // Several values per use still keep each use apart under append
+  if (action_ != actions::append) {
+    action_ = actions::extend;
+  }
   return *this;
 }
 
 auto parsing::Action::action(actions value) -> parsing::Action& {
   _check("action");
-  // if (nargs_ != "@") {
+  // if (nargs_ != nargstypes::exact) {
   //   error("Action", "argument action cannot be set after explicitly setting nargs");
   //   std::quick_exit(1);
   // }
@@ -110,6 +185,10 @@ auto parsing::Action::const_value(const std::string& value) -> parsing::Action&
 
 auto parsing::Action::type(const std::string& value) -> parsing::Action& {
   _check("type");
+  if (not get_valuetype(value, valuetype_)) {
+    error("Action", "type must be one of: 'string', 'int', 'uint', 'double', 'bool', 'size', 'duration'");
+    std::quick_exit(1);
+  }
   type_ = value;
   return *this;
 }
@@ -132,10 +211,45 @@ auto parsing::Action::required(bool value) -> parsing::Action& {
   return *this;
 }
 
-void parsing::Action::_check(const std::string& method) {
-  if (user_provided.count(method) == 1) {
-    error("Action", "cannot provide ." + method + " twice");
+auto parsing::Action::stream(std::function<void(std::string_view)> callback) -> parsing::Action& {
+  _check("stream");
+  if (argtype_ != argtypes::positional or (nargs_ != nargstypes::any and nargs_ != nargstypes::plus)) {
+    error("Action", "stream is only available on positional arguments with nargs '*' or '+' (set nargs first)");
+    std::quick_exit(1);
+  }
+  stream_ = std::move(callback);
+  return *this;
+}
+
+auto parsing::Action::stream_stdin(bool value) -> parsing::Action& {
+  _check("stream_stdin");
+  if (not stream_) {
+    error("Action", "stream_stdin requires stream to be set first");
+    std::quick_exit(1);
+  }
+  stream_stdin_ = value;
+  return *this;
+}
+
+auto parsing::Action::env(const std::string& name) -> parsing::Action& {
+  _check("env");
+  if (argtype_ == argtypes::positional) {
+    error("Action", "env is only available on optional arguments");
+    std::quick_exit(1);
+  }
+  if (name.empty() or name.find('=') != std::string::npos) {
+    error("Action", "env must be a non-empty variable name without '='");
+    std::quick_exit(1);
+  }
+  env_ = name;
+  return *this;
+}
+
+void parsing::Action::_check(std::string_view method) {
+  auto bit = static_cast<std::uint16_t>(1u << (std::find(once_methods.begin(), once_methods.end(), method) - once_methods.begin()));
+  if ((user_provided & bit) != 0) {
+    error("Action", "cannot provide ." + std::string(method) + " twice");
     std::quick_exit(1);
   }
-  user_provided[method] = true;
+  user_provided |= bit;
 }
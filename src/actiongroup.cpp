@@ -3,30 +3,110 @@
 
 
 // ActionGroup definition
-parsing::ActionGroup::ActionGroup(ArgumentParser& parent, std::string name) : parent(parent), name(std::move(name)) {}
+parsing::ActionGroup::ActionGroup(ArgumentParser& parent, std::string_view name, const allocator_type& alloc)
+  : parent(&parent)
+  , name(name, alloc)
+  , arguments(alloc)
+  , flags(alloc)
+{}
+
+parsing::ActionGroup::ActionGroup(const ActionGroup& other) : ActionGroup(other, allocator_type()) {}
+
+parsing::ActionGroup::ActionGroup(const ActionGroup& other, const allocator_type& alloc)
+  : parent(other.parent)
+  , name(other.name, alloc)
+  , arguments(other.arguments, alloc)
+  , flags(alloc)
+{
+  reindex();
+}
+
+parsing::ActionGroup::ActionGroup(ActionGroup&& other, const allocator_type& alloc)
+  : parent(other.parent)
+  , name(std::move(other.name), alloc)
+  , arguments(std::move(other.arguments), alloc)
+  , flags(alloc)
+{
+  reindex();
+}
+
+parsing::ActionGroup& parsing::ActionGroup::operator=(const ActionGroup& other) {
+  if (this == &other) {
+    return *this;
+  }
+  parent = other.parent;
+  name = other.name;
+  arguments = other.arguments;
+  reindex();
+  return *this;
+}
+
+parsing::ActionGroup& parsing::ActionGroup::operator=(ActionGroup&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  parent = other.parent;
+  name = std::move(other.name);
+  arguments = std::move(other.arguments);
+  reindex();
+  return *this;
+}
+
+void parsing::ActionGroup::reindex() {
+  flags.clear();
+  for (auto& argument : arguments) {
+    if (argument.argtype_ == argtypes::optional) {
+      for (auto& flag : argument.flags_) {
+        flags.emplace(flag, argument);
+      }
+    }
+  }
+}
 
 auto parsing::ActionGroup::add_argument(const std::string& value) -> parsing::Action& {
   if (value.substr(0, 1) == "-") {
     return add_argument({value});
   }
-  arguments.emplace_back(value);
-  return arguments.back();
+  // A group in a core other parsers share gets its counterpart in a new one to add to instead
+  auto& group = parent->writable(*this);
+  if (&group != this) {
+    return group.add_argument(value);
+  }
+  auto& core = *parent->m.core;
+  auto& argument = arguments.emplace_back(value);
+  argument.index_ = core.action_count++;
+  argument.core_ = &core;
+  parent->invalidate();
+  return argument;
 }
 
 auto parsing::ActionGroup::add_argument(const std::initializer_list<std::string>& values) -> parsing::Action& {
-  for (auto& group : parent.m.groups) {
-    for (auto& flag : values) {
-      if (group.flags.count(flag) > 0) {
-        error("Action", "duplicate flags: " + group.flags.at(flag).flags_string_ + " uses " + flag);
-        std::quick_exit(1);
-      }
+  auto& group = parent->writable(*this);
+  if (&group != this) {
+    return group.add_argument(values);
+  }
+  auto& core = *parent->m.core;
+  // Parsers loaded from an image skip these maps until something is added
+  if (not core.flags_indexed) {
+    for (auto& own : core.groups) {
+      own.reindex();
+    }
+    core.flags_indexed = true;
+  }
+  for (auto& flag : values) {
+    if (const auto* existing = core.find_flag(flag)) {
+      error("Action", "duplicate flags: " + std::string(existing->flags_string_) + " uses " + flag);
+      std::quick_exit(1);
     }
   }
-  arguments.emplace_back(values);
+  auto& argument = arguments.emplace_back(values);
+  argument.index_ = core.action_count++;
+  argument.core_ = &core;
+  parent->invalidate();
   if (get_argtype(values) == argtypes::optional) {
     for (auto& flag : values) {
-      flags.emplace(flag, arguments.back());
+      flags.emplace(flag, argument);
     }
   }
-  return arguments.back();
+  return argument;
 }
@@ -1,53 +1,208 @@
 #include "parsing/argumentparser.hpp"
 
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
+
+extern char** environ;
+
+
+namespace {
+  struct Outside {
+    parsing::errors code = parsing::errors::none;
+    std::string_view token;
+    std::size_t count = 0;
+  };
+
+  // Takes values given outside the command line (a defaults file entry, an environment variable)
+  // the way the command line would have. Consuming actions split a lone string on whitespace and
+  // are held to their nargs; store_true and store_false take a boolean and store what giving (or
+  // not giving) the flag would mean; the other constants are stored when it's true; count takes
+  // the count. Everything is checked before `emit` sees any of it.
+  template <typename Emit>
+  auto take_outside(const parsing::Action& argument, const std::string_view* values, std::size_t count, bool list, Emit&& emit) -> Outside {
+    using parsing::actions;
+    using parsing::errors;
+    auto each_word = [](std::string_view text, auto&& visit) {
+      for (std::size_t start = 0; start < text.size();) {
+        start = text.find_first_not_of(" \t", start);
+        if (start == text.npos) {
+          break;
+        }
+        auto end = std::min(text.find_first_of(" \t", start), text.size());
+        visit(text.substr(start, end - start));
+        start = end;
+      }
+    };
+
+    switch (argument.action_) {
+      case actions::store:
+      case actions::append:
+      case actions::extend: {
+        bool split = argument.max_nargs_ != 1 and not list and count == 1;
+        std::size_t words = count;
+        std::string_view last = count > 0 ? values[count - 1] : std::string_view();
+        if (split) {
+          words = 0;
+          each_word(values[0], [&](std::string_view word){ ++words; last = word; });
+        }
+        if (words < argument.min_nargs_) {
+          return {errors::missing_value, {}, words};
+        }
+        if (argument.max_nargs_ > 0 and words > argument.max_nargs_) {
+          return {errors::unexpected_value, last, 0};
+        }
+        if (split) {
+          each_word(values[0], emit);
+        }
+        else {
+          std::for_each(values, values + count, emit);
+        }
+        return {};
+      }
+      case actions::store_true:
+      case actions::store_false:
+      case actions::store_const:
+      case actions::append_const:
+      case actions::count: {
+        if (count == 0) {
+          return {};
+        }
+        if (count > 1) {
+          return {errors::unexpected_value, values[count - 1], 0};
+        }
+        auto type = argument.action_ == actions::count ? parsing::valuetypes::int64 : parsing::valuetypes::boolean;
+        parsing::Value given{};
+        if (not parsing::convert(type, values[0], given)) {
+          return {errors::invalid_value, values[0], 0};
+        }
+        if (argument.action_ == actions::count) {
+          emit(values[0]);
+        }
+        else if (argument.action_ == actions::store_true or argument.action_ == actions::store_false) {
+          emit((given.u != 0) == (argument.action_ == actions::store_true) ? std::string_view("true") : std::string_view("false"));
+        }
+        else if (given.u != 0) {
+          emit(std::string_view(argument.const_));
+        }
+        return {};
+      }
+      default: {
+        return count > 0 ? Outside{errors::unexpected_value, values[0], 0} : Outside{};
+      }
+    }
+  }
+}
 
 
 // ArgumentParser definition
 parsing::ArgumentParser::ArgumentParser(M m) : m(std::move(m)) {}
 
-parsing::ArgumentParser::ArgumentParser(const ArgumentParser& other) : m(other.m) {}
+parsing::ArgumentParser::ArgumentParser(const ArgumentParser& other) : m(other.m), flag_table(other.flag_table), dest_table(other.dest_table) {}
 
 parsing::ArgumentParser& parsing::ArgumentParser::operator=(const ArgumentParser& other) {
   if (this == &other) {
     return *this;
   }
-  ArgumentParser temp(other);
-  std::swap(m, temp.m);
+  m = other.m;
+  flag_table = other.flag_table;
+  dest_table = other.dest_table;
   return *this;
 }
 
-parsing::ArgumentParser::ArgumentParser(ArgumentParser&& other) : m(std::exchange(other.m, M{})) {}
+parsing::ArgumentParser::ArgumentParser(ArgumentParser&& other) : m(std::exchange(other.m, M{})), flag_table(std::move(other.flag_table)), dest_table(std::move(other.dest_table)) {
+  // Groups point back at their parser, so after a move they have to be told where they live now
+  if (m.core and m.core->owner == &other) {
+    m.core->adopt(*this);
+  }
+}
 
 parsing::ArgumentParser& parsing::ArgumentParser::operator=(ArgumentParser&& other) {
-  ArgumentParser temp(std::move(other));
-  std::swap(m, temp.m);
+  if (this == &other) {
+    return *this;
+  }
+  m = std::exchange(other.m, M{});
+  flag_table = std::move(other.flag_table);
+  dest_table = std::move(other.dest_table);
+  if (m.core and m.core->owner == &other) {
+    m.core->adopt(*this);
+  }
   return *this;
 }
 
-parsing::ArgumentParser parsing::ArgumentParser::create_parser(std::string value) {
+parsing::ArgumentParser parsing::ArgumentParser::create_parser(std::string value, std::pmr::memory_resource* resource) {
   ArgumentParser ap(M{std::move(value)});
+  ap.m.core = std::allocate_shared<ParserCore>(std::pmr::polymorphic_allocator<ParserCore>(resource), resource);
   ap.add_argument_group("Positional Arguments");
   ap.add_argument_group("Options");
   ap.add_help(true);
   return ap;
 }
 
+parsing::ArgumentParser parsing::ArgumentParser::create_parser(std::string value, const std::vector<std::reference_wrapper<const ArgumentParser>>& parents, std::pmr::memory_resource* resource) {
+  std::vector<std::shared_ptr<const ParserCore>> cores;
+  for (const ArgumentParser& parent : parents) {
+    cores.push_back(parent.m.core);
+  }
+  ArgumentParser ap(M{std::move(value)});
+  ap.m.core = std::allocate_shared<ParserCore>(std::pmr::polymorphic_allocator<ParserCore>(resource), resource, cores);
+  ap.add_argument_group("Positional Arguments");
+  ap.add_argument_group("Options");
+  const auto* help = ap.m.core->find_flag("--help");
+  if (help == nullptr) {
+    help = ap.m.core->find_flag("-h");
+  }
+  if (help == nullptr) {
+    ap.add_help(true);
+  }
+  else {
+    ap.m.help_added = help->action_ == actions::help;
+  }
+  return ap;
+}
+
+auto parsing::ArgumentParser::resource() const -> std::pmr::memory_resource* {
+  return m.core->resource();
+}
+
 auto parsing::ArgumentParser::add_argument_group(const std::string& name) -> ActionGroup& {
-  m.groups.emplace_back(*this, name);
-  return m.groups.back();
+  _own();
+  return m.core->add_group(*this, name);
+}
+
+auto parsing::ArgumentParser::writable(const ActionGroup& group) -> ActionGroup& {
+  _own();
+  for (auto& own : m.core->groups) {
+    if (&own == &group) {
+      return own;
+    }
+  }
+  for (auto& own : m.core->groups) {
+    if (own.name == group.name) {
+      return own;
+    }
+  }
+  return m.core->add_group(*this, group.name);
 }
 
 auto parsing::ArgumentParser::add_argument(const std::string& value) -> Action& {
   argtypes at_ = value.substr(0, 1) == "-" ? argtypes::optional : argtypes::positional;
   switch (at_) {
     case argtypes::positional: {
-      return m.groups.at(0).add_argument(value);
+      _own();
+      return m.core->groups.at(0).add_argument(value);
     }
     case argtypes::optional: {
-      return m.groups.at(1).add_argument(value);
+      _own();
+      return m.core->groups.at(1).add_argument(value);
     }
     default: {
-      error("ArgumentParser", "unrecognized argument type: " + argtype_mapping[at_]);
+      error("ArgumentParser", "unrecognized argument type: " + std::string(name_of(at_)));
       std::quick_exit(1);
     }
   }
@@ -57,13 +212,15 @@ auto parsing::ArgumentParser::add_argument(const std::initializer_list<std::stri
   argtypes at_ = get_argtype(values);
   switch (at_) {
     case argtypes::positional: {
-      return m.groups.at(0).add_argument(values);
+      _own();
+      return m.core->groups.at(0).add_argument(values);
     }
     case argtypes::optional: {
-      return m.groups.at(1).add_argument(values);
+      _own();
+      return m.core->groups.at(1).add_argument(values);
     }
     default: {
-      error("ArgumentParser", "unrecognized argument type: " + argtype_mapping[at_]);
+      error("ArgumentParser", "unrecognized argument type: " + std::string(name_of(at_)));
       std::quick_exit(1);
     }
   }
@@ -72,22 +229,82 @@ auto parsing::ArgumentParser::add_argument(const std::initializer_list<std::stri
 void parsing::ArgumentParser::add_help(bool value) {
   if (value) {
     if (not m.help_added and not m.help_removed) {
-      m.groups.at(1).add_argument({"--help", "-h"}).action(actions::help).help("Show this menu and exit.");
+      _own();
+      m.core->groups.at(1).add_argument({"--help", "-h"}).action(actions::help).help("Show this menu and exit.");
       m.help_added = true;
     }
+    return;
+  }
+  if (m.help_removed or not m.help_added) {
+    return;
+  }
+  const Action* help = nullptr;
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      if (argument.action_ == actions::help) {
+        help = &argument;
+      }
+    }
+  }
+  if (help == nullptr) {
+    return;
+  }
+  for (auto& flag : help->flags_) {
+    if (flag != "-h" and flag != "--help") {
+      return;
+    }
+  }
+  if (m.core.use_count() == 1 and not m.core->groups.at(1).arguments.empty() and &m.core->groups.at(1).arguments.front() == help) {
+    _own();
+    auto& options = m.core->groups.at(1);
+    for (auto& flag : help->flags_) {
+      options.flags.erase(flag);
+    }
+    options.arguments.pop_front();
   }
   else {
-    if (not m.help_removed and m.help_added) {
-      for (auto& flag : m.groups.at(1).arguments.front().flags_) {
-        if (flag != "-h" and flag != "--help") {
-          return;
+    // Help lives in a layer other parsers share, so this parser gets every layer copied into
+    // one core of its own, without it; indices stay as they were, as after an erase
+    auto* resource = this->resource();
+    auto core = std::allocate_shared<ParserCore>(std::pmr::polymorphic_allocator<ParserCore>(resource), resource);
+    core->action_count = m.core->size();
+    for (const auto* group : m.core->all_groups) {
+      ActionGroup* target = nullptr;
+      for (auto& own : core->groups) {
+        if (own.name == group->name) {
+          target = &own;
+        }
+      }
+      if (target == nullptr) {
+        target = &core->add_group(*this, group->name);
+      }
+      for (auto& argument : group->arguments) {
+        if (&argument == help) {
+          continue;
         }
-        m.groups.at(1).flags.erase(flag);
+        auto& copy = target->arguments.emplace_back(argument);
+        copy.index_ = m.core->index(argument);
+        copy.core_ = core.get();
       }
-      m.groups.at(1).arguments.erase(m.groups.at(1).arguments.begin());
-      m.help_removed = true;
     }
+    for (auto& group : core->groups) {
+      group.reindex();
+    }
+    core->owner = this;
+    m.core = std::move(core);
+  }
+  m.help_removed = true;
+  invalidate();
+}
+
+auto parsing::ArgumentParser::add_subparsers(const std::string& title) -> Subparsers& {
+  if (not m.subparsers.empty()) {
+    error("ArgumentParser", "cannot have multiple subparser arguments");
+    std::quick_exit(1);
   }
+  m.subparsers.emplace_back();
+  m.subparsers.back().title = title;
+  return m.subparsers.back();
 }
 
 void parsing::ArgumentParser::show_help() const {
@@ -98,30 +315,36 @@ void parsing::ArgumentParser::show_help() const {
   }
   else {
     oss << "Usage: " << m.name;
-    for (auto& group : m.groups) {
-      for (auto& argument: group.arguments) {
+    for (const auto* group : m.core->all_groups) {
+      for (auto& argument: group->arguments) {
         if (argument.argtype_ == argtypes::optional) {
           continue;
         }
-        if (argument.nargs_ == "@") {
-          oss << " " << argument.metavar_;
-        }
-        else if (argument.nargs_ == "?") {
-          oss << " [" << argument.metavar_ << " ...]";
-        }
-        else if (argument.nargs_ == "*") {
-          oss << " [" << argument.metavar_ << " ...]";
-        }
-        else if (argument.nargs_ == "+") {
-          oss << " " << argument.metavar_ << " [" << argument.metavar_ << " ...]";
+        switch (argument.nargs_) {
+          case nargstypes::exact: {
+            oss << " " << argument.metavar_;
+            break;
+          }
+          case nargstypes::optional:
+          case nargstypes::any: {
+            oss << " [" << argument.metavar_ << " ...]";
+            break;
+          }
+          case nargstypes::plus: {
+            oss << " " << argument.metavar_ << " [" << argument.metavar_ << " ...]";
+            break;
+          }
         }
       }
     }
-    for (auto& group : m.groups) {
-      if (group.arguments.empty()) {
+    if (not m.subparsers.empty()) {
+      oss << " COMMAND ...";
+    }
+    for (const auto* group : m.core->all_groups) {
+      if (group->arguments.empty()) {
         continue;
       }
-      for (auto& argument: group.arguments) {
+      for (auto& argument: group->arguments) {
         if (argument.argtype_ == argtypes::positional) {
           continue;
         }
@@ -145,41 +368,62 @@ void parsing::ArgumentParser::show_help() const {
 
   auto spaces = [](std::size_t n){ return std::string(n, ' '); };
 
-  // Argument Groups
-  for (auto& group : m.groups) {
-    if (group.arguments.empty()) {
-      continue;
+  // Argument Groups; layers can each have one of the same name (their own "Options", say),
+  // which show as one
+  std::vector<std::string_view> titles;
+  for (const auto* group : m.core->all_groups) {
+    if (not group->arguments.empty() and std::find(titles.begin(), titles.end(), group->name) == titles.end()) {
+      titles.push_back(group->name);
     }
-    oss << group.name << '\n';
-    for (auto& argument : group.arguments) {
-      if (argument.argtype_ == argtypes::positional) {
-        // Positionals
-        oss << spaces(4) << argument.dest_ << '\n';
-        if (not argument.help_.empty()) {
-          oss << spaces(8) << argument.help_ << '\n';
-        }
+  }
+  for (auto title : titles) {
+    oss << title << '\n';
+    for (const auto* group : m.core->all_groups) {
+      if (group->name != title) {
+        continue;
       }
-      else if (argument.argtype_ == argtypes::optional) {
-        // Optionals
-        oss << spaces(4) << argument.flags_string_;
-        if (not (argument.action_ == actions::store_true
-              or argument.action_ == actions::store_false
-              or argument.action_ == actions::store_const
-              or argument.action_ == actions::append_const
-              or argument.action_ == actions::help
-              or argument.action_ == actions::version
-              or argument.action_ == actions::count
-        )) {
-          oss << "=" << argument.metavar_;
+      for (auto& argument : group->arguments) {
+        if (argument.argtype_ == argtypes::positional) {
+          // Positionals
+          oss << spaces(4) << argument.dest_ << '\n';
+          if (not argument.help_.empty()) {
+            oss << spaces(8) << argument.help_ << '\n';
+          }
+        }
+        else if (argument.argtype_ == argtypes::optional) {
+          // Optionals
+          oss << spaces(4) << argument.flags_string_;
+          if (not (argument.action_ == actions::store_true
+                or argument.action_ == actions::store_false
+                or argument.action_ == actions::store_const
+                or argument.action_ == actions::append_const
+                or argument.action_ == actions::help
+                or argument.action_ == actions::version
+                or argument.action_ == actions::count
+          )) {
+            oss << "=" << argument.metavar_;
+          }
+          oss << '\n';
+          if (not argument.help_.empty()) {
+            oss << spaces(8) << argument.help_ << '\n';
+          }
         }
-        oss << '\n';
-        if (not argument.help_.empty()) {
-          oss << spaces(8) << argument.help_ << '\n';
+        else {
+          error("Help", "invalid argtype; could not complete help menu formatting");
+          std::quick_exit(1);
         }
       }
-      else {
-        error("Help", "invalid argtype; could not complete help menu formatting");
-        std::quick_exit(1);
+    }
+    oss << '\n';
+  }
+
+  // Subcommands, from their names alone; none of their parsers get built for this
+  for (auto& subparsers : m.subparsers) {
+    oss << subparsers.title << '\n';
+    for (auto& entry : subparsers.entries) {
+      oss << spaces(4) << entry.name << '\n';
+      if (not entry.help.empty()) {
+        oss << spaces(8) << entry.help << '\n';
       }
     }
     oss << '\n';
@@ -195,261 +439,859 @@ void parsing::ArgumentParser::show_help() const {
   std::cout.flush();
 }
 
+auto parsing::ArgumentParser::completion_index() const -> std::string {
+  std::string index(completion_header);
+  _completion_entries("", index);
+  return index;
+}
 
-auto parsing::ArgumentParser::parse_args(const std::deque<std::string>& values) const -> std::unordered_map<std::string, Result> {
-  std::deque<std::string> args(values.begin(), values.end());
-  std::unordered_map<std::string, Result> results;
-  std::deque<std::string> remaining;
+void parsing::ArgumentParser::_completion_entries(const std::string& scope, std::string& index) const {
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      if (argument.argtype_ != argtypes::optional) {
+        continue;
+      }
+      for (auto& flag : argument.flags_) {
+        index.append(scope).append("\t").append(flag).append("\n");
+      }
+    }
+  }
+  for (auto& subparsers : m.subparsers) {
+    for (auto& entry : subparsers.entries) {
+      index.append(scope).append("\t").append(entry.name).append("\n");
+      std::string name(entry.name);
+      auto child = create_parser(m.name + " " + name);
+      entry.build(child);
+      child._completion_entries(scope.empty() ? name : scope + " " + name, index);
+    }
+  }
+}
 
-  for (auto arg = args.begin(), end = args.end(); arg != end; ++arg) {
-    // If it looks like an optional argument
-    if (arg->substr(0, 1) == "-") {
+void parsing::ArgumentParser::_own() {
+  if (m.core.use_count() > 1) {
+    // Copies or child parsers can see this core, so it stays as it is and changes go in a new
+    // one on top; the tables built so far still hold, since nothing has moved
+    auto* resource = this->resource();
+    m.core = std::allocate_shared<ParserCore>(std::pmr::polymorphic_allocator<ParserCore>(resource), resource, std::vector<std::shared_ptr<const ParserCore>>{m.core});
+    m.core->add_group(*this, "Positional Arguments");
+    m.core->add_group(*this, "Options");
+  }
+  if (m.core->owner != this) {
+    m.core->adopt(*this);
+  }
+}
 
-      // Handle --
-      if (*arg == "--") {
-        for (++arg; arg != end; ++arg) {
-          remaining.emplace_back(*arg);
+void parsing::ArgumentParser::_build_flags(FlagTable& table) const {
+  if (not m.image) {
+    table.build(*m.core);
+    return;
+  }
+  std::vector<const Action*> by_index(m.core->size(), nullptr);
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      by_index.at(m.core->index(argument)) = &argument;
+    }
+  }
+  m.image->restore(table, by_index);
+}
+
+void parsing::ArgumentParser::compile() {
+  auto table = std::make_shared<FlagTable>();
+  _build_flags(*table);
+  auto dests = std::make_shared<DestTable>();
+  dests->build(*m.core);
+  for (auto& subparsers : m.subparsers) {
+    subparsers.index();
+  }
+  flag_table = std::move(table);
+  dest_table = std::move(dests);
+}
+
+void parsing::ArgumentParser::invalidate() {
+  flag_table.reset();
+  dest_table.reset();
+  m.image.reset();
+}
+
+auto parsing::ArgumentParser::save_image(const std::string& path, std::uint64_t fingerprint) const -> bool {
+  std::string image;
+  if (not ParserImage::write(*this, fingerprint, image)) {
+    return false;
+  }
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (not out.write(image.data(), static_cast<std::streamsize>(image.size())) or not out.flush()) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+auto parsing::ArgumentParser::load_image(const std::string& path, std::uint64_t fingerprint) -> std::optional<ArgumentParser> {
+  auto image = std::make_shared<ParserImage>();
+  if (not image->open(path, fingerprint)) {
+    return std::nullopt;
+  }
+  const auto& header = *image->header;
+  std::optional<ArgumentParser> loaded(std::in_place, M{std::string(image->str(header.name))});
+  auto& parser = *loaded;
+  auto& m = parser.m;
+  m.core = std::make_shared<ParserCore>(std::pmr::get_default_resource());
+  auto& core = *m.core;
+  m.version = image->str(header.version);
+  m.usage = image->str(header.usage);
+  m.description = image->str(header.description);
+  m.explicit_name = header.explicit_name;
+  m.help_added = header.help_added;
+  m.help_removed = header.help_removed;
+  core.action_count = header.next_index;
+  m.fromfile_prefix_chars = image->str(header.fromfile_prefix_chars);
+  m.fromfile_mode = static_cast<rspmodes>(header.fromfile_mode);
+  m.allow_abbrev = header.allow_abbrev;
+
+  const auto* records = image->actions();
+  const auto* flags = image->flags();
+  for (const auto* group = image->groups(), * last = group + header.group_count; group != last; ++group) {
+    auto& target = core.add_group(parser, image->str(group->name));
+    for (std::uint32_t ix = group->first_action; ix < group->first_action + group->action_count; ++ix) {
+      const auto& record = records[ix];
+      auto& argument = target.arguments.emplace_back();
+      argument.flags_.reserve(record.flag_count);
+      for (std::uint32_t flag = record.first_flag; flag < record.first_flag + record.flag_count; ++flag) {
+        argument.flags_.emplace_back(image->str(flags[flag]));
+      }
+      argument.flags_string_ = image->str(record.flags_string);
+      argument.required_ = record.required;
+      argument.dest_ = image->str(record.dest);
+      argument.metavar_ = image->str(record.metavar);
+      argument.argtype_ = static_cast<argtypes>(record.argtype);
+      argument.type_ = image->str(record.type);
+      argument.valuetype_ = static_cast<valuetypes>(record.valuetype);
+      argument.default_ = image->str(record.default_value);
+      argument.const_ = image->str(record.const_value);
+      argument.nargs_ = static_cast<nargstypes>(record.nargs);
+      argument.action_ = static_cast<actions>(record.action);
+      argument.min_nargs_ = record.min_nargs;
+      argument.max_nargs_ = record.max_nargs;
+      argument.help_ = image->str(record.help);
+      argument.index_ = record.index;
+      argument.core_ = &core;
+      argument.env_ = image->str(record.env);
+    }
+  }
+  m.image = std::move(image);
+  core.owner = &parser;
+  core.flags_indexed = false;
+  return loaded;
+}
+
+void parsing::ArgumentParser::load_defaults(const std::string& path) {
+  auto loaded = try_load_defaults(path);
+  if (not loaded) {
+    error("parser", loaded.error.message());
+    std::quick_exit(1);
+  }
+}
+
+auto parsing::ArgumentParser::try_load_defaults(const std::string& path) -> ParseResult {
+  // Errors point into the file, so whatever happens the result keeps it alive
+  auto file = std::make_shared<DefaultsFile>();
+  ParseResult loaded;
+  loaded.values.backing.push_back(file);
+  auto fail = [&](errors code, const Action* action, std::string_view token, std::size_t count) {
+    loaded.outcome = outcomes::error;
+    loaded.error.code = code;
+    loaded.error.action = action;
+    loaded.error.token = token;
+    loaded.error.count = count;
+    return std::move(loaded);
+  };
+  if (not file->load(path, loaded.error)) {
+    loaded.outcome = outcomes::error;
+    return loaded;
+  }
+
+  std::unordered_multimap<std::string_view, const Action*> by_dest;
+  by_dest.reserve(m.core->size());
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      if (argument.action_ != actions::help and argument.action_ != actions::version) {
+        by_dest.emplace(argument.dest_, &argument);
+      }
+    }
+  }
+
+  // Resolve entries in file order, so a repeated key just takes over the action's range
+  file->ranges.assign(m.core->size(), {0, 0});
+  std::vector<std::string_view> split;
+  for (auto& entry : file->entries) {
+    auto [first, last] = by_dest.equal_range(entry.key);
+    if (first == last) {
+      return fail(errors::unknown_key, nullptr, entry.key, entry.line);
+    }
+    for (; first != last; ++first) {
+      const auto* action = first->second;
+      const auto& argument = *action;
+      split.clear();
+      auto taken = take_outside(argument, file->values.data() + entry.first, entry.count, entry.list, [&split](std::string_view value){ split.push_back(value); });
+      if (taken.code == errors::missing_value) {
+        return fail(errors::missing_value, action, entry.key, taken.count);
+      }
+      if (taken.code != errors::none) {
+        return fail(taken.code, action, taken.token, 0);
+      }
+      for (auto value : split) {
+        Value scratch;
+        if (argument.valuetype_ != valuetypes::string and not convert(argument.valuetype_, value, scratch)) {
+          return fail(errors::invalid_value, action, value, 0);
         }
-        break;
       }
+      file->ranges.at(m.core->index(argument)) = {static_cast<std::uint32_t>(file->resolved.size()), static_cast<std::uint32_t>(split.size())};
+      file->resolved.insert(file->resolved.end(), split.begin(), split.end());
+    }
+  }
+  m.defaults_files.push_back(std::move(file));
+  return loaded;
+}
 
-      auto group = m.groups.begin();
 
-      // Get group where flag might be in
-      for (; group != m.groups.end(); ++group) {
-        if (group->flags.count(*arg) == 1) {
-          break;
+auto parsing::ArgumentParser::parse_args(const std::vector<std::string_view>& args) const -> Namespace {
+  return _unwrap(try_parse_args(args));
+}
+
+auto parsing::ArgumentParser::parse_args(const std::vector<std::string_view>& args, std::pmr::memory_resource* resource) const -> Namespace {
+  return _unwrap(try_parse_args(args, resource));
+}
+
+auto parsing::ArgumentParser::parse_args(const std::deque<std::string>& values) const -> Namespace {
+  return _unwrap(try_parse_args(values));
+}
+
+auto parsing::ArgumentParser::parse_args(int argc, char** argv) const -> Namespace {
+  return _unwrap(try_parse_args(argc, argv));
+}
+
+auto parsing::ArgumentParser::parse_line(std::string_view line, ShellTokenizer::expander expand, std::pmr::memory_resource* resource) const -> Namespace {
+  return _unwrap(try_parse_line(line, std::move(expand), resource));
+}
+
+auto parsing::ArgumentParser::parse_intermixed_args(const std::vector<std::string_view>& args) const -> Namespace {
+  return _unwrap(try_parse_intermixed_args(args));
+}
+
+auto parsing::ArgumentParser::parse_intermixed_args(int argc, char** argv) const -> Namespace {
+  return _unwrap(try_parse_intermixed_args(argc, argv));
+}
+
+auto parsing::ArgumentParser::_unwrap(ParseResult&& parsed) const -> Namespace {
+  switch (parsed.outcome) {
+    case outcomes::help: {
+      (parsed.parser == nullptr ? *this : *parsed.parser).show_help();
+      std::quick_exit(1);
+    }
+    case outcomes::version: {
+      std::cout << (parsed.parser == nullptr ? *this : *parsed.parser).m.version << '\n';
+      std::cout.flush();
+      std::quick_exit(1);
+    }
+    case outcomes::error: {
+      error("parser", parsed.error.message());
+      std::quick_exit(1);
+    }
+    default: {
+      break;
+    }
+  }
+  return std::move(parsed.values);
+}
+
+
+auto parsing::ArgumentParser::try_parse_args(const std::deque<std::string>& values) const -> ParseResult {
+  return try_parse_args(std::vector<std::string_view>(values.begin(), values.end()));
+}
+
+auto parsing::ArgumentParser::try_parse_args(int argc, char** argv) const -> ParseResult {
+  return try_parse_args(std::vector<std::string_view>(argv, argv+argc));
+}
+
+auto parsing::ArgumentParser::try_parse_args(const std::vector<std::string_view>& args) const -> ParseResult {
+  return try_parse_args(args, std::pmr::get_default_resource());
+}
+
+auto parsing::ArgumentParser::try_parse_intermixed_args(const std::vector<std::string_view>& args) const -> ParseResult {
+  return try_parse_args(args);
+}
+
+auto parsing::ArgumentParser::try_parse_intermixed_args(int argc, char** argv) const -> ParseResult {
+  return try_parse_args(argc, argv);
+}
+
+auto parsing::ArgumentParser::try_parse_args(const std::vector<std::string_view>& args, std::pmr::memory_resource* resource) const -> ParseResult {
+  FlagTable local_table;
+  std::shared_ptr<const DestTable> layout;
+  const auto& table = _tables(local_table, layout);
+  return _try_parse(args, table, layout, resource);
+}
+
+auto parsing::ArgumentParser::try_parse_line(std::string_view line, ShellTokenizer::expander expand, std::pmr::memory_resource* resource) const -> ParseResult {
+  using Words = std::pmr::forward_list<std::pmr::string>;
+  ShellTokenizer tokenizer(line, std::move(expand));
+  Words owned(resource);
+  std::pmr::vector<std::string_view> args(resource);
+  std::string_view word;
+  while (tokenizer.next(word, owned)) {
+    args.push_back(word);
+  }
+  if (tokenizer.failed) {
+    ParseResult parsed;
+    parsed.outcome = outcomes::error;
+    parsed.error.code = errors::malformed_line;
+    parsed.error.position = static_cast<std::ptrdiff_t>(args.size());
+    return parsed;
+  }
+
+  FlagTable local_table;
+  std::shared_ptr<const DestTable> layout;
+  const auto& table = _tables(local_table, layout);
+  auto parsed = _try_parse(args, table, layout, resource);
+  // Moving the list keeps its nodes where they are, so the views stay good
+  if (not owned.empty()) {
+    parsed.values.backing.push_back(std::allocate_shared<Words>(std::pmr::polymorphic_allocator<Words>(resource), std::move(owned)));
+  }
+  return parsed;
+}
+
+auto parsing::ArgumentParser::parse_batch(const std::vector<std::vector<std::string_view>>& batch, std::size_t threads, const std::function<std::pmr::memory_resource*(std::size_t ix)>& resource_for) const -> std::vector<ParseResult> {
+  std::vector<ParseResult> parsed(batch.size());
+  if (batch.empty()) {
+    return parsed;
+  }
+
+  // Built once up front and only read from here on, whether or not compile() was called
+  FlagTable local_table;
+  std::shared_ptr<const DestTable> layout;
+  const auto& table = _tables(local_table, layout);
+
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, batch.size());
+
+  // Workers claim small chunks off a shared cursor, so a slow stretch of the batch never holds
+  // up the rest, and each result lands in its own slot, which keeps them in order
+  const std::size_t chunk = std::max<std::size_t>(1, batch.size() / (threads * 16));
+  std::atomic<std::size_t> cursor {0};
+  std::exception_ptr failure;
+  std::mutex failure_mutex;
+  auto work = [&]() {
+    try {
+      for (auto begin = cursor.fetch_add(chunk); begin < batch.size(); begin = cursor.fetch_add(chunk)) {
+        for (auto ix = begin, end = std::min(begin + chunk, batch.size()); ix < end; ++ix) {
+          parsed[ix] = _try_parse(batch[ix], table, layout, resource_for ? resource_for(ix) : std::pmr::get_default_resource());
         }
+      }
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(failure_mutex);
+      if (not failure) {
+        failure = std::current_exception();
+      }
+      cursor.store(batch.size());
+    }
+  };
 
-        if (arg->find("=") != arg->npos) {
-          auto left = arg->substr(0, arg->find("="));
-          if (group->flags.count(left) == 1) {
-            args.insert(arg + 1, arg->substr(left.size() + 1));
-            *arg = left;
-            end = args.end();
-            break;
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (std::size_t ix = 1; ix < threads; ++ix) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+  return parsed;
+}
+
+auto parsing::ArgumentParser::_tables(FlagTable& local_table, std::shared_ptr<const DestTable>& layout) const -> const FlagTable& {
+  // Use the compiled tables when there are some, otherwise build throwaway ones
+  if (flag_table and dest_table) {
+    layout = dest_table;
+    return *flag_table;
+  }
+  _build_flags(local_table);
+  auto dests = std::make_shared<DestTable>();
+  dests->build(*m.core);
+  layout = std::move(dests);
+  return local_table;
+}
+
+auto parsing::ArgumentParser::_try_parse(ArgSpan args, const FlagTable& table, const std::shared_ptr<const DestTable>& layout, std::pmr::memory_resource* resource) const -> ParseResult {
+  auto is_file = [this](std::string_view arg){ return not arg.empty() and m.fromfile_prefix_chars.find(arg.front()) != std::string::npos; };
+  if (m.fromfile_prefix_chars.empty() or std::none_of(args.begin(), args.end(), is_file)) {
+    auto parsed = _parse(args, table, layout, resource);
+    PARSING_STATS_FINISH(parsed);
+    return parsed;
+  }
+
+  // Splice in argument files; the namespace keeps them mapped since its values point into them
+  auto files = std::make_shared<ResponseFiles>();
+  std::vector<std::string_view> expanded;
+  ParseResult parsed;
+  PARSING_STATS_ENTER(parsed, expand);
+  if (not files->expand(args, m.fromfile_prefix_chars, m.fromfile_mode, expanded, parsed.error)) {
+    parsed.outcome = outcomes::error;
+    parsed.values.backing.push_back(std::move(files));
+    PARSING_STATS_FINISH(parsed);
+    return parsed;
+  }
+#if PARSING_STATS
+  // The expansion was timed before the parse's own result existed, so it's carried over
+  auto expand_start = parsed.stats.started;
+  auto expand_end = ParseStats::now();
+  parsed = _parse(expanded, table, layout, resource);
+  parsed.stats.record(ParseStats::phases::expand, expand_start, expand_end);
+#else
+  parsed = _parse(expanded, table, layout, resource);
+#endif
+  parsed.values.backing.push_back(std::move(files));
+  PARSING_STATS_FINISH(parsed);
+  return parsed;
+}
+
+auto parsing::ArgumentParser::_parse(ArgSpan args, const FlagTable& table, const std::shared_ptr<const DestTable>& layout, std::pmr::memory_resource* resource) const -> ParseResult {
+  // Enough arena for every token to land in a slot, plus slack for the vectors doubling
+  ParseResult parsed{outcomes::parsed, Namespace(layout, (args.size() + layout->names.size()) * sizeof(std::string_view) * 2 + layout->names.size() * sizeof(Result) + args.size() * sizeof(std::size_t), resource), {}};
+  auto& results = parsed.values;
+
+  auto fail = [&parsed](errors code, std::ptrdiff_t position, const Action* action, std::string_view token = {}, std::size_t count = 0) {
+    parsed.outcome = outcomes::error;
+    parsed.error.code = code;
+    parsed.error.position = position;
+    parsed.error.action = action;
+    parsed.error.token = token;
+    parsed.error.count = count;
+  };
+
+  // Classify everything up front; from here on the input is only read, never rewritten
+  PARSING_STATS_ENTER(parsed, lex);
+  auto tokens = lex(args, table.numeric_flags, &results.storage->arena);
+  PARSING_STATS_ADD(parsed, tokens, tokens.size());
+
+  // Where each free positional token is, in order, wherever it fell between the optionals. With
+  // subcommands, the first one past this parser's own positionals is the command.
+  std::pmr::vector<std::size_t> unclaimed(&results.storage->arena);
+  unclaimed.reserve(tokens.size());
+  std::size_t command_ix = tokens.size();
+
+  // Applies one occurrence of an optional, consuming whatever values follow it; false means stop
+  const std::size_t end = tokens.size();
+  auto apply = [&](const Action& opt, std::size_t& ix, std::string_view arg, bool has_attached, std::string_view attached) -> bool {
+    auto slot = layout->slot(opt);
+    bool repeatable = opt.action_ == actions::count or opt.action_ == actions::append_const or opt.action_ == actions::append;
+    if (results.storage->provided[slot] and not repeatable) {
+      fail(errors::already_provided, ix, &opt, arg);
+      return false;
+    }
+    results.storage->provided[slot] = true;
+    if (has_attached and opt.action_ != actions::store and opt.action_ != actions::append and opt.action_ != actions::extend) {
+      fail(errors::unexpected_value, ix, &opt, attached);
+      return false;
+    }
+
+    switch (opt.action_) {
+      // Handle non-consuming options
+      case actions::store_true:
+      case actions::store_false:
+      case actions::store_const: {
+        results[slot].prepend(opt.const_);
+        return true;
+      }
+      case actions::append_const: {
+        results[slot].append(opt.const_);
+        return true;
+      }
+      // Counted in place; the text is written once the loop is done
+      case actions::count: {
+        auto& result = results[slot];
+        if (result.type != valuetypes::int64) {
+          Value start{};
+          if (opt.default_.empty() or not convert(valuetypes::int64, opt.default_, start)) {
+            start.i = 0;
           }
+          result.typed.assign(1, start);
+          result.type = valuetypes::int64;
         }
+        ++result.typed[0].i;
+        return true;
       }
-
-      // Unrecognized optional argument
-      if (group == m.groups.end()) {
-        error("parser", "unrecognized optional argument: " + (*arg));
-        std::quick_exit(1);
+      case actions::version: {
+        parsed.outcome = outcomes::version;
+        return false;
       }
-
-      // Handle valid optional arguments
-      auto opt = group->flags.at(*arg);
-      if (results.count(opt.dest_) == 1) {
-        error("parser", "optional argument already provided: " + opt.flags_string_);
-        std::quick_exit(1);
+      case actions::help: {
+        parsed.outcome = outcomes::help;
+        return false;
       }
 
-      switch (opt.action_) {
-        // Handle non-consuming options
-        case actions::store_true:
-        case actions::store_false:
-        case actions::store_const: {
-          results[opt.dest_].prepend(opt.const_);
-          break;
+      // Handle consuming options
+      case actions::store:
+      case actions::append:
+      case actions::extend: {
+        auto& result = results[slot];
+        if (opt.action_ == actions::store) {
+          result.clear();
         }
-        case actions::count:
-        case actions::append_const: {
-          results[opt.dest_].append(opt.const_);
-          break;
+        // Each use of an append option is counted from where it starts in the flat values
+        if (opt.action_ == actions::append) {
+          result.begin_occurrence();
         }
-        case actions::version: {
-          std::cout << m.version << '\n';
-          std::cout.flush();
-          std::quick_exit(1);
-        }
-        case actions::help: {
-          show_help();
-          std::quick_exit(1);
+        auto first = result.size();
+        if (has_attached) {
+          result.append(attached);
         }
-
-        // Handle consuming options
-        case actions::store:
-        case actions::extend: {
-          if (opt.action_ == actions::store) {
-            results[opt.dest_].clear();
-          }
-          while ((arg + 1) != end) {
-            ++arg;
-            if (arg->substr(0, 1) == "-") {
-              error("parser", opt.flags_string_ + " expects exactly " + repr(opt.min_nargs_) + " value(s), but got ambiguous value: " + repr(*arg));
-              std::quick_exit(1);
-            }
-            results[opt.dest_].append(*arg);
-            if (opt.max_nargs_ > 0 and results[opt.dest_].size() == opt.max_nargs_) {
+        while (ix + 1 < end and not (opt.max_nargs_ > 0 and result.size() - first == opt.max_nargs_)) {
+          // A variadic option ends at the next flag once it has what it needs
+          if (tokens[ix + 1].kind != tokenkinds::positional) {
+            if (result.size() - first >= opt.min_nargs_) {
               break;
             }
+            fail(errors::ambiguous_value, ix + 1, &opt, tokens[ix + 1].text);
+            return false;
           }
-          if (results[opt.dest_].size() < opt.min_nargs_) {
-            if (opt.min_nargs_ == opt.max_nargs_) {
-              error("parser", opt.flags_string_ + " expects exactly " + repr(opt.min_nargs_) + " value(s), but got " + repr(results[opt.dest_].size()));
-              std::quick_exit(1);
-            }
-            error("parser", opt.flags_string_ + " expects at least " + repr(opt.min_nargs_) + " value(s), but got " + repr(results[opt.dest_].size()));
-            std::quick_exit(1);
-          }
-          break;
+          ++ix;
+          result.append(tokens[ix].text);
+          tokens[ix].kind = tokenkinds::value;
         }
-        case actions::append: {
-          error("parser", "not yet implemented: " + action_mapping[opt.action_]);
-          std::quick_exit(1);
-        }
-        default: {
-          error("parser", "unrecognized action: " + action_mapping[opt.action_]);
-          std::quick_exit(1);
+        if (result.size() - first < opt.min_nargs_) {
+          fail(errors::missing_value, ix, &opt, arg, result.size() - first);
+          return false;
         }
+        return true;
+      }
+      default: {
+        fail(errors::unsupported_action, ix, &opt, arg);
+        return false;
       }
+    }
+  };
+
+  PARSING_STATS_ENTER(parsed, optionals);
+  for (std::size_t ix = 0; ix < end; ++ix) {
+    const auto& token = tokens[ix];
+    std::string_view arg = token.text;
+
+    // Handle --
+    if (token.kind == tokenkinds::separator) {
       continue;
     }
 
-    // Positional
-    remaining.emplace_back(*arg);
-  }
+    // If it looks like an optional argument
+    if (token.kind == tokenkinds::optional) {
+
+      // Walks the flag trie for the whole token, the left side of --flag=value, or an abbreviation
+      auto match = table.match(arg, token.has_value() ? token.eq : std::string_view::npos, m.allow_abbrev);
+      PARSING_STATS_ADD(parsed, lookups, 1);
+      if (match.ambiguous) {
+        fail(errors::ambiguous_option, ix, nullptr, arg);
+        parsed.error.extra = table.candidates(match);
+        return parsed;
+      }
+      const Action* found = match.action;
+      bool has_attached = match.length < arg.size();
+      std::string_view attached = has_attached ? arg.substr(match.length + 1) : std::string_view();
 
-  // Add default arguments
-  for (auto& group : m.groups) {
-    for (auto& argument : group.arguments) {
-      if (not argument.default_.empty()) {
-        if (results[argument.dest_].empty()) {
-          results[argument.dest_].append(argument.default_);
+      // Unrecognized optional argument, unless it's a cluster of short flags like -xzf or -j8
+      if (found == nullptr) {
+        if (arg.size() <= 2 or arg[0] != '-' or arg[1] == '-') {
+          fail(errors::unrecognized_optional, ix, nullptr, arg);
+          return parsed;
+        }
+        auto at = ix;
+        for (std::size_t pos = 1; pos < arg.size(); ++pos) {
+          const auto* opt = table.shorts[static_cast<unsigned char>(arg[pos])];
+          PARSING_STATS_ADD(parsed, lookups, 1);
+          if (opt == nullptr) {
+            fail(errors::unrecognized_optional, at, nullptr, arg);
+            return parsed;
+          }
+          // The first one that takes a value gets the rest of the cluster as it
+          auto rest = arg.substr(pos + 1);
+          if (opt->max_nargs_ != 0) {
+            if (not apply(*opt, ix, arg, not rest.empty(), rest)) {
+              return parsed;
+            }
+            break;
+          }
+          if (not apply(*opt, ix, arg, false, {})) {
+            return parsed;
+          }
         }
+        continue;
       }
+
+      if (not apply(*found, ix, arg, has_attached, attached)) {
+        return parsed;
+      }
+      continue;
+    }
+
+    // Positional
+    if (not m.subparsers.empty() and unclaimed.size() == layout->positional_min) {
+      command_ix = ix;
+      break;
     }
+    unclaimed.push_back(ix);
   }
 
-  // Check for required optionals
-  for (auto& group : m.groups) {
-    for (auto& argument : group.arguments) {
-      if (argument.argtype_ == argtypes::positional) {
+  // Counters get their text once, however many times they were hit
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      auto& result = results[argument];
+      if (argument.action_ != actions::count or result.type != valuetypes::int64 or not result.values.empty()) {
         continue;
       }
-      if (argument.required_ and results[argument.dest_].empty()) {
-        error("parser", "missing required optional argument: " + argument.flags_string_);
-        std::quick_exit(1);
-      }
+      auto* text = static_cast<char*>(results.storage->arena.allocate(20, 1));
+      auto written = std::to_chars(text, text + 20, result.typed[0].i).ptr;
+      result.values.assign(1, std::string_view(text, static_cast<std::size_t>(written - text)));
     }
   }
 
-  // Now for the confusing task of arranging positional arguments when positional argument count can be variable
-  std::size_t lower = 0;
-  bool exact = true;
-
-  // Get the min and max number of required arguments, and whether there are any that don't need to be exact
-  for (auto& group : m.groups) {
-    for (const auto& argument: group.arguments) {
-      if (argument.argtype_ == argtypes::optional) {
+  // One pass over the environment picks out just the variables some action falls back to
+  PARSING_STATS_ENTER(parsed, environment);
+  std::pmr::vector<std::string_view> env_values(&results.storage->arena);
+  if (not layout->envs.empty()) {
+    env_values.resize(layout->action_slots.size());
+    for (char** entry = environ; entry != nullptr and *entry != nullptr; ++entry) {
+      std::string_view variable(*entry);
+      auto eq = variable.find('=');
+      if (eq == std::string_view::npos) {
+        continue;
+      }
+      auto [first, last] = layout->envs.equal_range(variable.substr(0, eq));
+      if (first == last) {
         continue;
       }
-      if (argument.nargs_ == "?" or argument.nargs_ == "*" or argument.nargs_ == "+") {
-        exact = false;
+      // Copied, since the environment can be changed after the parse
+      auto value = variable.substr(eq + 1);
+      auto* copy = static_cast<char*>(results.storage->arena.allocate(value.size(), 1));
+      std::copy(value.begin(), value.end(), copy);
+      for (; first != last; ++first) {
+        env_values[first->second] = std::string_view(copy, value.size());
       }
-      lower += argument.min_nargs_;
     }
   }
 
-  // Check for too few arguments
-  if (remaining.size() < lower) {
-    std::size_t subtotal = 0;
-    for (auto& group : m.groups) {
-      for (auto& argument : group.arguments) {
-        if (argument.argtype_ == argtypes::optional) {
+  // Add default arguments: the environment first, then defaults files, then default_value
+  PARSING_STATS_ENTER(parsed, defaults);
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      if (not results[argument].empty()) {
+        continue;
+      }
+      auto index = layout->index(argument);
+      if (index < env_values.size() and env_values[index].data() != nullptr) {
+        auto& result = results[argument];
+        auto taken = take_outside(argument, &env_values[index], 1, false, [&result](std::string_view value){ result.append(value); });
+        if (taken.code != errors::none) {
+          fail(taken.code, -1, &argument, taken.code == errors::missing_value ? std::string_view(argument.env_) : taken.token, taken.count);
+          return parsed;
+        }
+        // A false constant leaves it to the layers below
+        if (not result.empty()) {
           continue;
         }
-        subtotal += argument.min_nargs_;
-        if (subtotal > remaining.size()) {
-          error("parser", "missing positional argument: " + argument.flags_string_);
-          std::quick_exit(1);
+      }
+      auto layer = m.defaults_files.rbegin();
+      for (; layer != m.defaults_files.rend(); ++layer) {
+        auto [values, count] = (*layer)->lookup(index);
+        for (std::size_t ix = 0; ix < count; ++ix) {
+          results[argument].append(values[ix]);
+        }
+        if (count > 0) {
+          break;
         }
       }
+      if (layer == m.defaults_files.rend() and not argument.default_.empty()) {
+        results[argument].append(argument.default_);
+      }
     }
   }
 
-  // If it's exact, then we have exactly the right amount
-  if (exact) {
-    for (auto& group : m.groups) {
-      for (auto& argument: group.arguments) {
-        if (argument.argtype_ == argtypes::optional) {
-          continue;
-        }
-        for (std::size_t ix = 0; ix < argument.min_nargs_; ++ix) {
-          results[argument.dest_].append(remaining.front());
-          remaining.pop_front();
-        }
+  // Check for required optionals
+  PARSING_STATS_ENTER(parsed, required);
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      if (argument.argtype_ == argtypes::positional) {
+        continue;
+      }
+      if (argument.required_ and results[argument].empty()) {
+        fail(errors::missing_required, -1, &argument);
+        return parsed;
       }
     }
   }
 
-  // And finally, the check for variable number of arguments
-  else {
-    // Create layout of minimum required arguments per index
-    std::size_t known = 0;
-    for (auto& group : m.groups) {
-      for (auto& argument: group.arguments) {
-        if (argument.argtype_ == argtypes::optional) {
-          continue;
-        }
-        known += argument.min_nargs_;
+  // Positionals take values in order, in one pass: each gets as many as its nargs allows while
+  // leaving enough for the minimums of the ones after it
+  PARSING_STATS_ENTER(parsed, positionals);
+  const auto left = unclaimed.size();
+  if (left < layout->positional_min) {
+    for (const auto& positional : layout->positionals) {
+      if (positional.before + positional.min > left) {
+        fail(errors::missing_positional, -1, positional.action);
+        return parsed;
       }
     }
+  }
 
-    // Distribute them
-    for (auto& group : m.groups) {
-      for (auto& argument: group.arguments) {
-        if (argument.argtype_ == argtypes::optional) {
-          continue;
-        }
-
-        if (argument.nargs_ == "@") {
-          for (std::size_t ix = 0; ix < argument.min_nargs_; ++ix) {
-            results[argument.dest_].append(remaining.front());
-            remaining.pop_front();
-            known--;
-          }
-        }
-
-        else if (argument.nargs_ == "?") {
-          if (remaining.size() > known) {
-            results[argument.dest_].append(remaining.front());
-            remaining.pop_front();
-          }
-        }
+  // Streamed actions only note where their run starts in `unclaimed`, and get it once the parse
+  // has succeeded
+  struct Run {
+    const Action* action;
+    std::size_t first;
+    std::size_t count;
+  };
+  std::pmr::vector<Run> streamed(&results.storage->arena);
+  std::size_t cursor = 0;
+  for (const auto& positional : layout->positionals) {
+    auto after = layout->positional_min - positional.before - positional.min;
+    auto count = std::min(positional.max, left - cursor - after);
+    if (count == 0) {
+      continue;
+    }
+    if (positional.action->stream_) {
+      streamed.push_back({positional.action, cursor, count});
+    }
+    else {
+      auto& values = results[positional.slot].values;
+      values.reserve(values.size() + count);
+      for (auto ix = cursor; ix < cursor + count; ++ix) {
+        values.push_back(tokens[unclaimed[ix]].text);
+      }
+    }
+    cursor += count;
+  }
 
-        else if (argument.nargs_ == "*") {
-          while (remaining.size() > known) {
-            results[argument.dest_].append(remaining.front());
-            remaining.pop_front();
-          }
-        }
+  // If any left over, then we need to error
+  if (cursor < left) {
+    fail(errors::unrecognized_positional, unclaimed[cursor], nullptr, tokens[unclaimed[cursor]].text);
+    for (; cursor < left; ++cursor) {
+      parsed.error.extra.push_back(tokens[unclaimed[cursor]].text);
+    }
+    return parsed;
+  }
 
-        else if (argument.nargs_ == "+") {
-          known--;
-          do {
-            results[argument.dest_].append(remaining.front());
-            remaining.pop_front();
-          } while (remaining.size() > known);
+  // Convert typed arguments once here, so the accessors never have to
+  PARSING_STATS_ENTER(parsed, convert);
+  for (const auto* group : m.core->all_groups) {
+    for (auto& argument : group->arguments) {
+      if (argument.valuetype_ == valuetypes::string) {
+        continue;
+      }
+      auto& result = results[argument];
+      if (result.type != valuetypes::string) {
+        continue;
+      }
+      result.typed.resize(result.values.size());
+      for (std::size_t ix = 0; ix < result.values.size(); ++ix) {
+        if (not convert(argument.valuetype_, result.values[ix], result.typed[ix])) {
+          fail(errors::invalid_value, -1, &argument, result.values[ix]);
+          return parsed;
         }
+      }
+      result.type = argument.valuetype_;
+    }
+  }
 
+  // Streamed values are checked as they go, since they never land in a Result to convert
+  PARSING_STATS_ENTER(parsed, stream);
+  auto deliver = [&](const Action& argument, std::string_view value) {
+    Value scratch;
+    if (argument.valuetype_ != valuetypes::string and not convert(argument.valuetype_, value, scratch)) {
+      // The value may live in a read buffer that's about to go away, so the error keeps a copy
+      auto* copy = static_cast<char*>(results.storage->arena.allocate(value.size(), 1));
+      std::copy(value.begin(), value.end(), copy);
+      fail(errors::invalid_value, -1, &argument, std::string_view(copy, value.size()));
+      return false;
+    }
+    argument.stream_(value);
+    return true;
+  };
+  for (const auto& run : streamed) {
+    const auto& argument = *run.action;
+    auto first = unclaimed[run.first];
+    if (argument.stream_stdin_ and run.count == 1 and tokens[first].text == "-") {
+      std::size_t delivered = 0;
+      bool valid = true;
+      if (not RecordReader{STDIN_FILENO}.each([&](std::string_view value){ ++delivered; return valid = deliver(argument, value); })) {
+        fail(errors::unreadable_input, first, &argument);
+        return parsed;
+      }
+      if (not valid) {
+        return parsed;
+      }
+      if (delivered < argument.min_nargs_) {
+        fail(errors::missing_positional, first, &argument);
+        return parsed;
+      }
+      continue;
+    }
+    for (auto ix = run.first; ix < run.first + run.count; ++ix) {
+      if (not deliver(argument, tokens[unclaimed[ix]].text)) {
+        return parsed;
       }
     }
   }
 
-  // If any left over, then we need to error
-  if (not remaining.empty()) {
-    error("ArgumentParser", "(this is probably a bug in the parser, honestly) unrecognized arguments: " + reprjoin(" ", remaining));
-    std::quick_exit(1);
+  // Only now is the chosen subcommand's parser built, and only that one
+  if (not m.subparsers.empty()) {
+    PARSING_STATS_ENTER(parsed, subcommand);
+    const auto& subparsers = m.subparsers.front();
+    if (command_ix == tokens.size()) {
+      if (subparsers.required) {
+        fail(errors::missing_command, -1, nullptr);
+        for (auto& entry : subparsers.entries) {
+          parsed.error.extra.push_back(entry.name);
+        }
+      }
+      return parsed;
+    }
+    auto command = tokens[command_ix].text;
+    const auto* entry = subparsers.find(command);
+    if (entry == nullptr) {
+      fail(errors::unknown_command, command_ix, nullptr, command);
+      return parsed;
+    }
+    auto child = std::allocate_shared<ArgumentParser>(std::pmr::polymorphic_allocator<ArgumentParser>(resource), create_parser(m.name + " " + std::string(entry->name), resource));
+    entry->build(*child);
+    FlagTable child_table;
+    std::shared_ptr<const DestTable> child_layout;
+    const auto& child_flags = child->_tables(child_table, child_layout);
+    auto sub = child->_try_parse(ArgSpan(args.begin() + command_ix + 1, args.size() - command_ix - 1), child_flags, child_layout, resource);
+    // Results and errors point into the child parser, so the namespace keeps it
+    results.command = command;
+    results.backing.push_back(child);
+    if (not sub) {
+      parsed.outcome = sub.outcome;
+      parsed.error = std::move(sub.error);
+      if (parsed.error.position >= 0) {
+        parsed.error.position += static_cast<std::ptrdiff_t>(command_ix + 1);
+      }
+      parsed.parser = sub.parser == nullptr ? child.get() : sub.parser;
+    }
+    results.subcommand = std::make_unique<Namespace>(std::move(sub.values));
   }
 
   // Finally, return
-  return results;
-}
-
-
-auto parsing::ArgumentParser::parse_args(int argc, char** argv) const -> std::unordered_map<std::string, Result> {
-  return parse_args(std::deque<std::string>(argv, argv+argc));
+  return parsed;
 }
 
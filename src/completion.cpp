@@ -0,0 +1,114 @@
+#include "parsing/completion.hpp"
+
+
+namespace {
+  // Calls `visit(word)` for every entry of `scope`, stopping when it returns false
+  template<typename F>
+  void each_word(std::string_view index, std::string_view scope, F visit) {
+    std::size_t start = parsing::completion_header.size();
+    while (start < index.size()) {
+      auto end = index.find('\n', start);
+      if (end == index.npos) {
+        end = index.size();
+      }
+      auto line = index.substr(start, end - start);
+      auto tab = line.find('\t');
+      if (tab != line.npos and line.substr(0, tab) == scope and not visit(line.substr(tab + 1))) {
+        return;
+      }
+      start = end + 1;
+    }
+  }
+
+  auto function_name(const std::string& program) -> std::string {
+    std::string name = "_";
+    for (char c : program) {
+      name.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    return name + "_complete";
+  }
+}
+
+
+auto parsing::complete(std::string_view index, const std::vector<std::string_view>& words, std::size_t cword) -> std::vector<std::string_view> {
+  std::vector<std::string_view> candidates;
+  if (index.substr(0, completion_header.size()) != completion_header) {
+    return candidates;
+  }
+
+  // Follow subcommand names to find which parser the cursor is in
+  std::string scope;
+  for (std::size_t ix = 1; ix < cword and ix < words.size(); ++ix) {
+    auto word = words[ix];
+    if (word == "--") {
+      return candidates;
+    }
+    if (word.empty() or word.front() == '-') {
+      continue;
+    }
+    bool command = false;
+    each_word(index, scope, [&](std::string_view entry){ return not (command = entry == word); });
+    if (command) {
+      scope += scope.empty() ? std::string(word) : " " + std::string(word);
+    }
+  }
+
+  // Flags only once the word starts with '-', subcommands otherwise
+  std::string_view prefix = cword < words.size() ? words[cword] : std::string_view();
+  bool flags = not prefix.empty() and prefix.front() == '-';
+  each_word(index, scope, [&](std::string_view entry){
+    if (not entry.empty() and (entry.front() == '-') == flags and entry.substr(0, prefix.size()) == prefix) {
+      candidates.push_back(entry);
+    }
+    return true;
+  });
+  return candidates;
+}
+
+auto parsing::handle_completion(std::string_view index, int argc, char** argv, std::ostream& out) -> bool {
+  if (argc < 3 or std::string_view(argv[1]) != "--_complete") {
+    return false;
+  }
+  std::size_t cword = 0;
+  std::string_view position(argv[2]);
+  std::from_chars(position.data(), position.data() + position.size(), cword);
+  std::vector<std::string_view> words(argv + 3, argv + argc);
+  std::string reply;
+  for (auto candidate : complete(index, words, cword)) {
+    reply.append(candidate);
+    reply.push_back('\n');
+  }
+  out << reply;
+  out.flush();
+  return true;
+}
+
+auto parsing::completion_script(shells shell, const std::string& program) -> std::string {
+  auto name = function_name(program);
+  switch (shell) {
+    case shells::bash: {
+      return name + "() {\n"
+        "  local IFS=$'\\n'\n"
+        "  COMPREPLY=($(" + program + " --_complete \"$COMP_CWORD\" \"${COMP_WORDS[@]}\" 2>/dev/null))\n"
+        "}\n"
+        "complete -o default -F " + name + " " + program + "\n";
+    }
+    case shells::zsh: {
+      return "#compdef " + program + "\n" +
+        name + "() {\n"
+        "  local -a candidates\n"
+        "  candidates=(\"${(@f)$(" + program + " --_complete $((CURRENT - 1)) \"${words[@]}\" 2>/dev/null)}\")\n"
+        "  if (( ${#candidates[@]} )) && [[ -n \"${candidates[1]}\" ]]; then\n"
+        "    compadd -a candidates\n"
+        "  else\n"
+        "    _files\n"
+        "  fi\n"
+        "}\n"
+        "compdef " + name + " " + program + "\n";
+    }
+    case shells::fish: {
+      return "complete -c " + program + " -a '(" + program + " --_complete (count (commandline -opc)) (commandline -opc) (commandline -ct))'\n";
+    }
+  }
+  return "";
+}
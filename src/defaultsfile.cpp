@@ -0,0 +1,316 @@
+#include "parsing/defaultsfile.hpp"
+
+#include <algorithm>
+
+
+namespace {
+  auto is_space(char c) -> bool {
+    return c == ' ' or c == '\t' or c == '\r' or c == '\n' or c == '\f' or c == '\v';
+  }
+
+  auto trim(std::string_view text) -> std::string_view {
+    while (not text.empty() and is_space(text.front())) {
+      text.remove_prefix(1);
+    }
+    while (not text.empty() and is_space(text.back())) {
+      text.remove_suffix(1);
+    }
+    return text;
+  }
+
+  // Appends the UTF-8 encoding of one code point
+  void encode_utf8(std::uint32_t point, std::string& out) {
+    if (point < 0x80) {
+      out += static_cast<char>(point);
+    }
+    else if (point < 0x800) {
+      out += static_cast<char>(0xc0 | (point >> 6));
+      out += static_cast<char>(0x80 | (point & 0x3f));
+    }
+    else if (point < 0x10000) {
+      out += static_cast<char>(0xe0 | (point >> 12));
+      out += static_cast<char>(0x80 | ((point >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (point & 0x3f));
+    }
+    else {
+      out += static_cast<char>(0xf0 | (point >> 18));
+      out += static_cast<char>(0x80 | ((point >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((point >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (point & 0x3f));
+    }
+  }
+
+  // Recursive descent over one flat JSON object; `pos` is always the next unread character
+  struct JsonReader {
+    std::string_view text;
+    std::size_t pos = 0;
+    std::forward_list<std::string>& owned;
+
+    void skip() {
+      while (pos < text.size() and is_space(text[pos])) {
+        ++pos;
+      }
+    }
+
+    auto eat(char c) -> bool {
+      skip();
+      if (pos < text.size() and text[pos] == c) {
+        ++pos;
+        return true;
+      }
+      return false;
+    }
+
+    auto hex4(std::uint32_t& out) -> bool {
+      if (pos + 4 > text.size()) {
+        return false;
+      }
+      out = 0;
+      for (std::size_t ix = 0; ix < 4; ++ix) {
+        char c = text[pos++];
+        out <<= 4;
+        if (c >= '0' and c <= '9') {
+          out |= static_cast<std::uint32_t>(c - '0');
+        }
+        else if (c >= 'a' and c <= 'f') {
+          out |= static_cast<std::uint32_t>(c - 'a' + 10);
+        }
+        else if (c >= 'A' and c <= 'F') {
+          out |= static_cast<std::uint32_t>(c - 'A' + 10);
+        }
+        else {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // A view into the file unless the string has escapes, in which case it's rebuilt in `owned`
+    auto string(std::string_view& out) -> bool {
+      if (not eat('"')) {
+        return false;
+      }
+      auto start = pos;
+      while (pos < text.size() and text[pos] != '"' and text[pos] != '\\') {
+        ++pos;
+      }
+      if (pos < text.size() and text[pos] == '"') {
+        out = text.substr(start, pos++ - start);
+        return true;
+      }
+
+      std::string value(text.substr(start, pos - start));
+      while (pos < text.size() and text[pos] != '"') {
+        char c = text[pos++];
+        if (c != '\\') {
+          value += c;
+          continue;
+        }
+        if (pos == text.size()) {
+          return false;
+        }
+        switch (char escaped = text[pos++]) {
+          case 'b': value += '\b'; break;
+          case 'f': value += '\f'; break;
+          case 'n': value += '\n'; break;
+          case 'r': value += '\r'; break;
+          case 't': value += '\t'; break;
+          case 'u': {
+            std::uint32_t point = 0;
+            if (not hex4(point)) {
+              return false;
+            }
+            // A surrogate pair spells one code point above the basic plane
+            if (point >= 0xd800 and point < 0xdc00 and text.substr(pos, 2) == "\\u") {
+              pos += 2;
+              std::uint32_t low = 0;
+              if (not hex4(low) or low < 0xdc00 or low >= 0xe000) {
+                return false;
+              }
+              point = 0x10000 + ((point - 0xd800) << 10) + (low - 0xdc00);
+            }
+            encode_utf8(point, value);
+            break;
+          }
+          case '"':
+          case '\\':
+          case '/': value += escaped; break;
+          default: return false;
+        }
+      }
+      if (pos == text.size()) {
+        return false;
+      }
+      ++pos;
+      owned.push_front(std::move(value));
+      out = owned.front();
+      return true;
+    }
+
+    // Strings, or the literal text of numbers and booleans; null leaves `out` empty-handed
+    auto scalar(std::string_view& out, bool& null) -> bool {
+      skip();
+      null = false;
+      if (pos == text.size()) {
+        return false;
+      }
+      if (text[pos] == '"') {
+        return string(out);
+      }
+      auto start = pos;
+      while (pos < text.size() and not is_space(text[pos]) and text[pos] != ',' and text[pos] != ']' and text[pos] != '}') {
+        ++pos;
+      }
+      out = text.substr(start, pos - start);
+      if (out == "null") {
+        null = true;
+        return true;
+      }
+      if (out == "true" or out == "false") {
+        return true;
+      }
+      parsing::Value number;
+      return parsing::convert(parsing::valuetypes::float64, out, number);
+    }
+  };
+}
+
+
+// DefaultsFile definition
+auto parsing::DefaultsFile::load(const std::string& path, ParseError& error) -> bool {
+  this->path = path;
+  if (not file.open(path)) {
+    error.code = errors::unreadable_config;
+    error.token = this->path;
+    return false;
+  }
+  auto text = file.view();
+  auto start = text.find_first_not_of(" \t\r\n");
+  if (start != text.npos and text[start] == '{') {
+    return _load_json(text, error);
+  }
+  return _load_ini(text, error);
+}
+
+auto parsing::DefaultsFile::lookup(std::size_t index) const -> std::pair<const std::string_view*, std::size_t> {
+  if (index >= ranges.size() or ranges[index].second == 0) {
+    return {nullptr, 0};
+  }
+  return {resolved.data() + ranges[index].first, ranges[index].second};
+}
+
+auto parsing::DefaultsFile::_load_ini(std::string_view text, ParseError& error) -> bool {
+  std::size_t line = 0;
+  for (std::size_t start = 0; start < text.size();) {
+    auto end = text.find('\n', start);
+    if (end == text.npos) {
+      end = text.size();
+    }
+    auto content = trim(text.substr(start, end - start));
+    start = end + 1;
+    ++line;
+
+    if (content.empty() or content.front() == '#' or content.front() == ';') {
+      continue;
+    }
+    if (content.front() == '[') {
+      if (content.back() != ']') {
+        error.code = errors::malformed_config;
+        error.token = path;
+        error.count = line;
+        return false;
+      }
+      continue;
+    }
+    auto eq = content.find('=');
+    auto key = trim(content.substr(0, eq));
+    if (eq == content.npos or key.empty()) {
+      error.code = errors::malformed_config;
+      error.token = path;
+      error.count = line;
+      return false;
+    }
+    auto value = trim(content.substr(eq + 1));
+    if (value.size() >= 2 and (value.front() == '"' or value.front() == '\'') and value.back() == value.front()) {
+      value = value.substr(1, value.size() - 2);
+    }
+    entries.push_back({key, values.size(), 1, line, false});
+    values.push_back(value);
+  }
+  return true;
+}
+
+auto parsing::DefaultsFile::_load_json(std::string_view text, ParseError& error) -> bool {
+  JsonReader reader{text, 0, owned};
+  // Lines are counted as the reader moves on, never again from the top
+  std::size_t line = 1;
+  std::size_t counted = 0;
+  auto line_at = [&](std::size_t pos) {
+    pos = std::min(pos, text.size());
+    if (pos > counted) {
+      line += static_cast<std::size_t>(std::count(text.begin() + counted, text.begin() + pos, '\n'));
+      counted = pos;
+    }
+    return line;
+  };
+  auto fail = [&]() {
+    error.code = errors::malformed_config;
+    error.token = path;
+    error.count = line_at(reader.pos);
+    return false;
+  };
+
+  if (not reader.eat('{')) {
+    return fail();
+  }
+  if (reader.eat('}')) {
+    reader.skip();
+    return reader.pos == text.size() ? true : fail();
+  }
+  do {
+    std::string_view key;
+    reader.skip();
+    auto key_line = line_at(reader.pos);
+    if (not reader.string(key) or not reader.eat(':')) {
+      return fail();
+    }
+    Entry entry{key, values.size(), 0, key_line, false};
+    std::string_view value;
+    bool null = false;
+    reader.skip();
+    if (reader.eat('[')) {
+      entry.list = true;
+      if (not reader.eat(']')) {
+        do {
+          if (not reader.scalar(value, null)) {
+            return fail();
+          }
+          if (not null) {
+            values.push_back(value);
+            ++entry.count;
+          }
+        } while (reader.eat(','));
+        if (not reader.eat(']')) {
+          return fail();
+        }
+      }
+    }
+    else {
+      if (not reader.scalar(value, null)) {
+        return fail();
+      }
+      if (not null) {
+        values.push_back(value);
+        entry.count = 1;
+      }
+    }
+    if (entry.count > 0 or entry.list) {
+      entries.push_back(entry);
+    }
+  } while (reader.eat(','));
+  if (not reader.eat('}')) {
+    return fail();
+  }
+  reader.skip();
+  return reader.pos == text.size() ? true : fail();
+}
@@ -0,0 +1,181 @@
+#include "parsing/flagtable.hpp"
+
+
+namespace {
+  struct Entry {
+    std::string_view flag;
+    const parsing::Action* action;
+  };
+
+  auto looks_negative(std::string_view value) -> bool {
+    return value.size() > 1 and value.front() == '-' and (std::isdigit(static_cast<unsigned char>(value[1])) or value[1] == '.');
+  }
+
+  // Fills in nodes[index] from entries[lo, hi), which are sorted and share their first `depth` characters
+  void build_node(std::vector<parsing::FlagTable::Node>& nodes, const std::vector<Entry>& entries, std::size_t lo, std::size_t hi, std::size_t depth, std::uint32_t index) {
+    if (lo < hi and entries[lo].flag.size() == depth) {
+      nodes[index].action = entries[lo].action;
+      nodes[index].flag = entries[lo].flag;
+      ++lo;
+    }
+
+    // One child per distinct next character, all allocated together so they end up adjacent
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    for (std::size_t start = lo; start < hi;) {
+      std::size_t end = start + 1;
+      while (end < hi and entries[end].flag[depth] == entries[start].flag[depth]) {
+        ++end;
+      }
+      runs.emplace_back(start, end);
+      start = end;
+    }
+    auto first = static_cast<std::uint32_t>(nodes.size());
+    nodes[index].first_child = first;
+    nodes[index].child_count = static_cast<std::uint32_t>(runs.size());
+    nodes.resize(nodes.size() + runs.size());
+
+    const parsing::Action* unique = nodes[index].action;
+    bool several = false;
+    for (std::size_t ix = 0; ix < runs.size(); ++ix) {
+      auto [start, end] = runs[ix];
+      // Sorted, so what the first and last share is what they all share
+      auto left = entries[start].flag;
+      auto right = entries[end - 1].flag;
+      std::size_t common = depth + 1;
+      while (common < left.size() and common < right.size() and left[common] == right[common]) {
+        ++common;
+      }
+      auto child = static_cast<std::uint32_t>(first + ix);
+      nodes[child].label = left.substr(depth, common - depth);
+      build_node(nodes, entries, start, end, common, child);
+
+      const auto* below = nodes[child].unique;
+      several = several or below == nullptr or (unique != nullptr and unique != below);
+      unique = unique == nullptr ? below : unique;
+    }
+    nodes[index].unique = several ? nullptr : unique;
+  }
+}
+
+
+// FlagTable definition
+void parsing::FlagTable::build(const ParserCore& core) {
+  std::vector<Entry> entries;
+  numeric_flags = false;
+  shorts.fill(nullptr);
+  for (const auto* group : core.all_groups) {
+    for (auto& argument : group->arguments) {
+      if (argument.argtype_ != argtypes::optional) {
+        continue;
+      }
+      for (auto& flag : argument.flags_) {
+        entries.push_back({flag, &argument});
+        if (flag.size() == 2 and flag[0] == '-' and flag[1] != '-') {
+          shorts[static_cast<unsigned char>(flag[1])] = &argument;
+        }
+        numeric_flags = numeric_flags or looks_negative(flag);
+      }
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right){ return left.flag < right.flag; });
+
+  nodes.assign(1, Node{});
+  nodes.reserve(entries.size() * 2);
+  build_node(nodes, entries, 0, entries.size(), 0, 0);
+  keys.resize(nodes.size());
+  for (std::size_t ix = 1; ix < nodes.size(); ++ix) {
+    keys[ix] = nodes[ix].label.front();
+  }
+  compiled = true;
+}
+
+void parsing::FlagTable::clear() {
+  nodes.clear();
+  keys.clear();
+  shorts.fill(nullptr);
+  compiled = false;
+  numeric_flags = false;
+}
+
+auto parsing::FlagTable::find(std::string_view flag) const -> const Action* {
+  bool partial = false;
+  auto node = _descend(flag, partial);
+  if (node == npos or partial) {
+    return nullptr;
+  }
+  return nodes[node].action;
+}
+
+auto parsing::FlagTable::match(std::string_view text, std::size_t eq, bool allow_abbrev) const -> Match {
+  if (const auto* action = find(text)) {
+    return {action, text.size()};
+  }
+  auto flag = text.substr(0, eq);
+  if (eq < text.size()) {
+    if (const auto* action = find(flag)) {
+      return {action, eq};
+    }
+  }
+  if (not allow_abbrev or flag.size() < 3 or flag.substr(0, 2) != "--") {
+    return {};
+  }
+  bool partial = false;
+  auto node = _descend(flag, partial);
+  if (node == npos) {
+    return {};
+  }
+  return {nodes[node].unique, flag.size(), nodes[node].unique == nullptr, node};
+}
+
+auto parsing::FlagTable::candidates(const Match& match) const -> std::vector<std::string_view> {
+  std::vector<std::string_view> flags;
+  std::vector<std::uint32_t> pending {match.node};
+  while (not pending.empty() and not nodes.empty()) {
+    const auto& node = nodes[pending.back()];
+    pending.pop_back();
+    if (node.action != nullptr) {
+      flags.push_back(node.flag);
+    }
+    for (auto ix = node.first_child + node.child_count; ix > node.first_child; --ix) {
+      pending.push_back(ix - 1);
+    }
+  }
+  return flags;
+}
+
+auto parsing::FlagTable::_descend(std::string_view text, bool& partial) const -> std::uint32_t {
+  partial = false;
+  if (nodes.empty()) {
+    return npos;
+  }
+  // Fanout is small and labels are short, so plain loops beat memchr and memcmp calls here
+  const char* key_data = keys.data();
+  const char* at = text.data();
+  const char* end = at + text.size();
+  std::uint32_t node = 0;
+  while (at < end) {
+    const auto& current = nodes[node];
+    std::uint32_t child = current.first_child;
+    std::uint32_t last = child + current.child_count;
+    while (child < last and key_data[child] != *at) {
+      ++child;
+    }
+    if (child == last) {
+      return npos;
+    }
+    auto label = nodes[child].label;
+    auto length = std::min<std::size_t>(label.size(), static_cast<std::size_t>(end - at));
+    for (std::size_t ix = 1; ix < length; ++ix) {
+      if (label[ix] != at[ix]) {
+        return npos;
+      }
+    }
+    at += length;
+    node = child;
+    if (length < label.size()) {
+      partial = true;
+      break;
+    }
+  }
+  return node;
+}
@@ -0,0 +1,238 @@
+#include "parsing/image.hpp"
+#include "parsing/argumentparser.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+  constexpr std::uint32_t endian_mark = 0x01020304;
+
+  auto narrow(std::size_t value) -> std::uint32_t {
+    return static_cast<std::uint32_t>(value);
+  }
+}
+
+
+// ParserImage definition
+auto parsing::ParserImage::write(const ArgumentParser& parser, std::uint64_t fingerprint, std::string& out) -> bool {
+  const auto& m = parser.m;
+  if (not m.subparsers.empty()) {
+    return false;
+  }
+  const auto& core = *m.core;
+  FlagTable local_table;
+  const FlagTable* table = parser.flag_table.get();
+  if (table == nullptr or not table->compiled) {
+    local_table.build(core);
+    table = &local_table;
+  }
+
+  std::string strings;
+  auto intern = [&strings](std::string_view text) {
+    Str value {narrow(strings.size()), narrow(text.size())};
+    strings.append(text);
+    return value;
+  };
+  auto index_of = [&core](const Action* action) {
+    return action == nullptr ? none : narrow(core.index(*action));
+  };
+
+  std::vector<GroupRecord> groups;
+  std::vector<ActionRecord> actions;
+  std::vector<Str> flags;
+  std::vector<std::string_view> titles;
+  for (const auto* group : core.all_groups) {
+    if (std::find(titles.begin(), titles.end(), group->name) == titles.end()) {
+      titles.push_back(group->name);
+    }
+  }
+  for (auto title : titles) {
+    groups.push_back({intern(title), narrow(actions.size()), 0});
+    for (const auto* group : core.all_groups) {
+      if (group->name != title) {
+        continue;
+      }
+      groups.back().action_count += narrow(group->arguments.size());
+      for (auto& argument : group->arguments) {
+        if (argument.stream_) {
+          return false;
+        }
+        ActionRecord record {};
+        record.flags_string = intern(argument.flags_string_);
+        record.dest = intern(argument.dest_);
+        record.metavar = intern(argument.metavar_);
+        record.type = intern(argument.type_);
+        record.default_value = intern(argument.default_);
+        record.const_value = intern(argument.const_);
+        record.help = intern(argument.help_);
+        record.env = intern(argument.env_);
+        record.min_nargs = argument.min_nargs_;
+        record.max_nargs = argument.max_nargs_;
+        record.index = narrow(core.index(argument));
+        record.first_flag = narrow(flags.size());
+        record.flag_count = narrow(argument.flags_.size());
+        record.action = static_cast<std::uint8_t>(argument.action_);
+        record.argtype = static_cast<std::uint8_t>(argument.argtype_);
+        record.valuetype = static_cast<std::uint8_t>(argument.valuetype_);
+        record.required = argument.required_;
+        record.nargs = static_cast<std::uint8_t>(argument.nargs_);
+        for (auto& flag : argument.flags_) {
+          flags.push_back(intern(flag));
+        }
+        actions.push_back(record);
+      }
+    }
+  }
+
+  std::vector<NodeRecord> nodes;
+  nodes.reserve(table->nodes.size());
+  for (auto& node : table->nodes) {
+    nodes.push_back({intern(node.label), intern(node.flag), node.first_child, node.child_count, index_of(node.action), index_of(node.unique)});
+  }
+  std::array<std::uint32_t, 256> shorts {};
+  for (std::size_t ix = 0; ix < shorts.size(); ++ix) {
+    shorts[ix] = index_of(table->shorts[ix]);
+  }
+
+  Header header {};
+  header.magic = magic;
+  header.format = format;
+  header.endian = endian_mark;
+  header.fingerprint = fingerprint;
+  header.header_size = sizeof(Header);
+  header.group_size = sizeof(GroupRecord);
+  header.action_size = sizeof(ActionRecord);
+  header.node_size = sizeof(NodeRecord);
+  header.group_count = narrow(groups.size());
+  header.action_count = narrow(actions.size());
+  header.flag_count = narrow(flags.size());
+  header.node_count = narrow(nodes.size());
+  header.next_index = narrow(core.size());
+  header.name = intern(m.name);
+  header.version = intern(m.version);
+  header.usage = intern(m.usage);
+  header.description = intern(m.description);
+  header.fromfile_prefix_chars = intern(m.fromfile_prefix_chars);
+  header.fromfile_mode = static_cast<std::uint8_t>(m.fromfile_mode);
+  header.explicit_name = m.explicit_name;
+  header.help_added = m.help_added;
+  header.help_removed = m.help_removed;
+  header.allow_abbrev = m.allow_abbrev;
+  header.numeric_flags = table->numeric_flags;
+
+  // Every section starts 8-aligned, so records can be read straight out of the mapping
+  out.assign(sizeof(Header), '\0');
+  auto place = [&out](const void* data, std::size_t bytes) -> std::uint64_t {
+    out.resize((out.size() + 7) / 8 * 8, '\0');
+    auto offset = out.size();
+    out.append(static_cast<const char*>(data), bytes);
+    return offset;
+  };
+  header.groups = place(groups.data(), groups.size() * sizeof(GroupRecord));
+  header.actions = place(actions.data(), actions.size() * sizeof(ActionRecord));
+  header.flags = place(flags.data(), flags.size() * sizeof(Str));
+  header.nodes = place(nodes.data(), nodes.size() * sizeof(NodeRecord));
+  header.keys = place(table->keys.data(), table->keys.size());
+  header.shorts = place(shorts.data(), sizeof(shorts));
+  header.strings = place(strings.data(), strings.size());
+  header.strings_size = strings.size();
+  out.resize((out.size() + 7) / 8 * 8, '\0');
+  header.size = out.size();
+  std::memcpy(out.data(), &header, sizeof(Header));
+  return strings.size() < UINT32_MAX;
+}
+
+auto parsing::ParserImage::open(const std::string& path, std::uint64_t fingerprint) -> bool {
+  header = nullptr;
+  if (not file.open(path) or file.size < sizeof(Header)) {
+    return false;
+  }
+  const auto* candidate = reinterpret_cast<const Header*>(file.data);
+  const auto& h = *candidate;
+  if (h.magic != magic or h.format != format or h.endian != endian_mark or h.fingerprint != fingerprint or h.size != file.size) {
+    return false;
+  }
+  if (h.header_size != sizeof(Header) or h.group_size != sizeof(GroupRecord) or h.action_size != sizeof(ActionRecord) or h.node_size != sizeof(NodeRecord)) {
+    return false;
+  }
+
+  // Bounds, so a truncated or hand-edited image is refused here rather than read past its end
+  auto fits = [&h](std::uint64_t offset, std::uint64_t count, std::uint64_t size) {
+    return offset % 8 == 0 and offset <= h.size and count <= (h.size - offset) / size;
+  };
+  if (not fits(h.groups, h.group_count, sizeof(GroupRecord)) or not fits(h.actions, h.action_count, sizeof(ActionRecord)) or not fits(h.flags, h.flag_count, sizeof(Str)) or not fits(h.nodes, h.node_count, sizeof(NodeRecord)) or not fits(h.keys, h.node_count, 1) or not fits(h.shorts, 256, sizeof(std::uint32_t)) or not fits(h.strings, h.strings_size, 1)) {
+    return false;
+  }
+  header = candidate;
+  auto valid = [&h](Str value) { return value.offset <= h.strings_size and value.size <= h.strings_size - value.offset; };
+  auto valid_index = [&h](std::uint32_t index) { return index == none or index < h.next_index; };
+  bool ok = h.node_count > 0 and valid(h.name) and valid(h.version) and valid(h.usage) and valid(h.description) and valid(h.fromfile_prefix_chars) and h.fromfile_mode <= static_cast<std::uint8_t>(rspmodes::shell);
+  const auto* group = groups();
+  for (std::uint32_t ix = 0; ok and ix < h.group_count; ++ix) {
+    ok = valid(group[ix].name) and group[ix].first_action <= h.action_count and group[ix].action_count <= h.action_count - group[ix].first_action;
+  }
+  const auto* action = actions();
+  for (std::uint32_t ix = 0; ok and ix < h.action_count; ++ix) {
+    const auto& record = action[ix];
+    ok = valid(record.flags_string) and valid(record.dest) and valid(record.metavar) and valid(record.type) and valid(record.default_value) and valid(record.const_value) and valid(record.help) and valid(record.env)
+      and record.index < h.next_index and record.first_flag <= h.flag_count and record.flag_count <= h.flag_count - record.first_flag
+      and record.action < action_names.size() and record.argtype < argtype_names.size() and record.valuetype < valuetype_names.size() and record.nargs < nargstype_names.size();
+  }
+  const auto* flag = flags();
+  for (std::uint32_t ix = 0; ok and ix < h.flag_count; ++ix) {
+    ok = valid(flag[ix]);
+  }
+  const auto* node = _at<NodeRecord>(h.nodes);
+  for (std::uint32_t ix = 0; ok and ix < h.node_count; ++ix) {
+    ok = valid(node[ix].label) and valid(node[ix].flag) and node[ix].first_child <= h.node_count and node[ix].child_count <= h.node_count - node[ix].first_child and valid_index(node[ix].action) and valid_index(node[ix].unique);
+  }
+  const auto* shorts = _at<std::uint32_t>(h.shorts);
+  for (std::size_t ix = 0; ok and ix < 256; ++ix) {
+    ok = valid_index(shorts[ix]);
+  }
+  if (not ok) {
+    header = nullptr;
+  }
+  return ok;
+}
+
+auto parsing::ParserImage::str(Str value) const -> std::string_view {
+  return std::string_view(file.data + header->strings + value.offset, value.size);
+}
+
+auto parsing::ParserImage::groups() const -> const GroupRecord* {
+  return _at<GroupRecord>(header->groups);
+}
+
+auto parsing::ParserImage::actions() const -> const ActionRecord* {
+  return _at<ActionRecord>(header->actions);
+}
+
+auto parsing::ParserImage::flags() const -> const Str* {
+  return _at<Str>(header->flags);
+}
+
+void parsing::ParserImage::restore(FlagTable& table, const std::vector<const Action*>& by_index) const {
+  auto action_at = [&by_index](std::uint32_t index) -> const Action* {
+    return index == none or index >= by_index.size() ? nullptr : by_index[index];
+  };
+  const auto* node = _at<NodeRecord>(header->nodes);
+  table.nodes.resize(header->node_count);
+  for (std::uint32_t ix = 0; ix < header->node_count; ++ix) {
+    table.nodes[ix] = {str(node[ix].label), str(node[ix].flag), node[ix].first_child, node[ix].child_count, action_at(node[ix].action), action_at(node[ix].unique)};
+  }
+  const auto* keys = _at<char>(header->keys);
+  table.keys.assign(keys, keys + header->node_count);
+  const auto* shorts = _at<std::uint32_t>(header->shorts);
+  for (std::size_t ix = 0; ix < table.shorts.size(); ++ix) {
+    table.shorts[ix] = action_at(shorts[ix]);
+  }
+  table.numeric_flags = header->numeric_flags;
+  table.compiled = true;
+}
+
+template <typename T>
+auto parsing::ParserImage::_at(std::uint64_t offset) const -> const T* {
+  return reinterpret_cast<const T*>(file.data + offset);
+}
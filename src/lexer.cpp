@@ -0,0 +1,48 @@
+#include "parsing/lexer.hpp"
+
+
+// Token definition
+auto parsing::Token::flag() const -> std::string_view {
+  return eq == npos ? text : text.substr(0, eq);
+}
+
+auto parsing::Token::value() const -> std::string_view {
+  return eq == npos ? std::string_view() : text.substr(eq + 1);
+}
+
+auto parsing::Token::has_value() const -> bool {
+  return eq != npos;
+}
+
+
+auto parsing::lex(ArgSpan args, bool numeric_flags, std::pmr::memory_resource* resource) -> std::pmr::vector<Token> {
+  std::pmr::vector<Token> tokens(resource);
+  tokens.reserve(args.size());
+
+  auto ix = args.begin();
+  for (auto end = args.end(); ix != end; ++ix) {
+    std::string_view text = *ix;
+    if (text.size() < 2 or text.front() != '-') {
+      tokens.push_back({text, Token::npos, tokenkinds::positional});
+      continue;
+    }
+    if (text.size() == 2 and text[1] == '-') {
+      tokens.push_back({text, Token::npos, tokenkinds::separator});
+      ++ix;
+      break;
+    }
+    if (not numeric_flags and (std::isdigit(static_cast<unsigned char>(text[1])) or text[1] == '.')) {
+      tokens.push_back({text, Token::npos, tokenkinds::positional});
+      continue;
+    }
+    // memchr is the vectorized scan here; '=' can't be at 0 since that's the '-'
+    const void* found = std::memchr(text.data() + 1, '=', text.size() - 1);
+    auto eq = found == nullptr ? Token::npos : static_cast<std::uint32_t>(static_cast<const char*>(found) - text.data());
+    tokens.push_back({text, eq, tokenkinds::optional});
+  }
+
+  for (auto end = args.end(); ix != end; ++ix) {
+    tokens.push_back({*ix, Token::npos, tokenkinds::positional});
+  }
+  return tokens;
+}
@@ -0,0 +1,197 @@
+#include "parsing/namespace.hpp"
+
+
+// DestTable definition
+void parsing::DestTable::build(const ParserCore& core) {
+  names.clear();
+  slots.clear();
+  env_actions.clear();
+  envs.clear();
+  positionals.clear();
+  positional_min = 0;
+  action_slots.assign(core.size(), npos);
+  layers.clear();
+  for (std::size_t ix = 0; ix < core.layers.size(); ++ix) {
+    layers.emplace_back(core.layers[ix], core.offsets[ix]);
+  }
+
+  std::unordered_map<std::string, std::size_t> seen;
+  for (const auto* group : core.all_groups) {
+    for (auto& argument : group->arguments) {
+      auto index = core.index(argument);
+      auto [it, inserted] = seen.emplace(argument.dest_, names.size());
+      if (inserted) {
+        names.emplace_back(argument.dest_);
+      }
+      action_slots.at(index) = it->second;
+      if (not argument.env_.empty()) {
+        env_actions.emplace_back(argument.env_, index);
+      }
+      if (argument.argtype_ == argtypes::positional) {
+        auto variadic = argument.nargs_ == nargstypes::any or argument.nargs_ == nargstypes::plus;
+        positionals.push_back({&argument, it->second, argument.nargs_, argument.min_nargs_, variadic ? npos : argument.max_nargs_, positional_min});
+        positional_min += argument.min_nargs_;
+      }
+    }
+  }
+
+  // Names are final now, so views into them stay put
+  slots.reserve(names.size());
+  for (std::size_t ix = 0; ix < names.size(); ++ix) {
+    slots.emplace(names[ix], ix);
+  }
+  envs.reserve(env_actions.size());
+  for (auto& [name, index] : env_actions) {
+    envs.emplace(name, index);
+  }
+}
+
+auto parsing::DestTable::find(std::string_view dest) const -> std::size_t {
+  auto it = slots.find(dest);
+  if (it == slots.end()) {
+    return npos;
+  }
+  return it->second;
+}
+
+auto parsing::DestTable::index(const Action& action) const -> std::size_t {
+  // A parser sees a handful of cores at most, so this is a short scan
+  for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+    if (layer->first == action.core_) {
+      return layer->second + action.index_;
+    }
+  }
+  return npos;
+}
+
+auto parsing::DestTable::slot(const Action& action) const -> std::size_t {
+  return action_slots.at(index(action));
+}
+
+
+// Namespace definition
+parsing::Namespace::Storage::Storage(std::size_t count, std::size_t capacity, std::pmr::memory_resource* upstream)
+#if PARSING_STATS
+  : counter(upstream)
+  , arena(std::max<std::size_t>(capacity, 64), &counter)
+#else
+  : arena(std::max<std::size_t>(capacity, 64), upstream)
+#endif
+  , slots(count, &arena)
+  , provided(count, false, &arena)
+{}
+
+void parsing::Namespace::Storage::Release::operator()(Storage* storage) const {
+  storage->~Storage();
+  resource->deallocate(storage, sizeof(Storage), alignof(Storage));
+}
+
+auto parsing::Namespace::Storage::make(std::size_t count, std::size_t capacity, std::pmr::memory_resource* upstream) -> std::unique_ptr<Storage, Release> {
+  void* memory = upstream->allocate(sizeof(Storage), alignof(Storage));
+  try {
+    return std::unique_ptr<Storage, Release>(new (memory) Storage(count, capacity, upstream), Release{upstream});
+  }
+  catch (...) {
+    upstream->deallocate(memory, sizeof(Storage), alignof(Storage));
+    throw;
+  }
+}
+
+parsing::Namespace::Namespace() : layout(std::make_shared<const DestTable>()), storage(Storage::make(0, 0, std::pmr::get_default_resource())) {}
+
+parsing::Namespace::Namespace(std::shared_ptr<const DestTable> layout, std::size_t capacity, std::pmr::memory_resource* upstream)
+  : layout(std::move(layout))
+  , storage(Storage::make(this->layout->names.size(), capacity, upstream))
+{}
+
+parsing::Namespace::Namespace(const Namespace& other)
+  : layout(other.layout)
+  , storage(Storage::make(other.size(), 0, std::pmr::get_default_resource()))
+  , backing(other.backing)
+  , command(other.command)
+  , subcommand(other.subcommand ? std::make_unique<Namespace>(*other.subcommand) : nullptr)
+{
+  // Assigned whole, so converted values come along; the vectors stay on this arena, since
+  // polymorphic allocators don't propagate on copy assignment
+  for (std::size_t ix = 0; ix < other.size(); ++ix) {
+    storage->slots[ix] = other.storage->slots[ix];
+    storage->provided[ix] = other.storage->provided[ix];
+  }
+}
+
+parsing::Namespace& parsing::Namespace::operator=(const Namespace& other) {
+  if (this == &other) {
+    return *this;
+  }
+  Namespace temp(other);
+  std::swap(layout, temp.layout);
+  std::swap(storage, temp.storage);
+  std::swap(backing, temp.backing);
+  std::swap(command, temp.command);
+  std::swap(subcommand, temp.subcommand);
+  return *this;
+}
+
+auto parsing::Namespace::operator[](std::size_t slot) -> Result& {
+  return storage->slots.at(slot);
+}
+
+auto parsing::Namespace::operator[](std::size_t slot) const -> const Result& {
+  return storage->slots.at(slot);
+}
+
+auto parsing::Namespace::operator[](const Action& action) -> Result& {
+  return storage->slots.at(layout->slot(action));
+}
+
+auto parsing::Namespace::operator[](const Action& action) const -> const Result& {
+  return storage->slots.at(layout->slot(action));
+}
+
+auto parsing::Namespace::operator[](std::string_view dest) const -> const Result& {
+  static const Result empty;
+  auto slot = layout->find(dest);
+  if (slot == DestTable::npos) {
+    return subcommand ? (*subcommand)[dest] : empty;
+  }
+  return storage->slots[slot];
+}
+
+auto parsing::Namespace::at(std::string_view dest) const -> const Result& {
+  auto slot = layout->find(dest);
+  if (slot == DestTable::npos and subcommand) {
+    return subcommand->at(dest);
+  }
+  if (slot == DestTable::npos) {
+    throw std::out_of_range("no such dest: " + std::string(dest));
+  }
+  return storage->slots[slot];
+}
+
+auto parsing::Namespace::count(std::string_view dest) const -> std::size_t {
+  auto slot = layout->find(dest);
+  if (slot == DestTable::npos and subcommand) {
+    return subcommand->count(dest);
+  }
+  if (slot == DestTable::npos or storage->slots[slot].values.empty()) {
+    return 0;
+  }
+  return 1;
+}
+
+auto parsing::Namespace::size() const -> std::size_t {
+  return storage->slots.size();
+}
+
+parsing::Namespace::operator std::unordered_map<std::string, Result>() const {
+  std::unordered_map<std::string, Result> results;
+  for (std::size_t ix = 0; ix < size(); ++ix) {
+    if (not storage->slots[ix].values.empty()) {
+      results.emplace(layout->names[ix], storage->slots[ix]);
+    }
+  }
+  if (subcommand) {
+    results.merge(std::unordered_map<std::string, Result>(*subcommand));
+  }
+  return results;
+}
@@ -0,0 +1,104 @@
+#include "parsing/parsercore.hpp"
+#include "parsing/argumentparser.hpp"
+
+#include <algorithm>
+
+
+// ParserCore definition
+parsing::ParserCore::ParserCore(std::pmr::memory_resource* resource, const std::vector<std::shared_ptr<const ParserCore>>& parents)
+  : parents(parents.begin(), parents.end(), resource)
+  , groups(resource)
+  , layers(resource)
+  , offsets(resource)
+  , all_groups(resource)
+{
+  // A core two parents share is only counted once
+  std::size_t total = 0;
+  for (auto& parent : this->parents) {
+    for (const auto* layer : parent->layers) {
+      if (std::find(layers.begin(), layers.end(), layer) != layers.end()) {
+        continue;
+      }
+      layers.push_back(layer);
+      offsets.push_back(total);
+      total += layer->action_count;
+      for (auto& group : layer->groups) {
+        all_groups.push_back(&group);
+      }
+    }
+  }
+  layers.push_back(this);
+  offsets.push_back(total);
+
+  // Parents made apart from each other can't be checked until they meet here
+  auto checked = this->parents.empty() ? layers.size() : this->parents.front()->layers.size();
+  for (auto ix = checked; ix + 1 < layers.size(); ++ix) {
+    for (auto& group : layers[ix]->groups) {
+      for (auto& argument : group.arguments) {
+        for (auto& flag : argument.flags_) {
+          const auto* existing = argument.argtype_ == argtypes::optional ? find_flag(flag, ix) : nullptr;
+          if (existing != nullptr) {
+            error("ArgumentParser", "duplicate flags across parents: " + std::string(existing->flags_string_) + " uses " + std::string(flag));
+            std::quick_exit(1);
+          }
+        }
+      }
+    }
+  }
+}
+
+auto parsing::ParserCore::resource() const -> std::pmr::memory_resource* {
+  return groups.get_allocator().resource();
+}
+
+auto parsing::ParserCore::size() const -> std::size_t {
+  return offsets.back() + action_count;
+}
+
+auto parsing::ParserCore::index(const Action& action) const -> std::size_t {
+  if (action.core_ == this) {
+    return offsets.back() + action.index_;
+  }
+  for (std::size_t ix = 0; ix < layers.size(); ++ix) {
+    if (layers[ix] == action.core_) {
+      return offsets[ix] + action.index_;
+    }
+  }
+  return npos;
+}
+
+auto parsing::ParserCore::find_flag(std::string_view flag, std::size_t layer_count) const -> const Action* {
+  std::pmr::string key(flag, resource());
+  for (std::size_t ix = 0; ix < std::min(layer_count, layers.size()); ++ix) {
+    const auto* layer = layers[ix];
+    for (auto& group : layer->groups) {
+      if (layer->flags_indexed) {
+        auto existing = group.flags.find(key);
+        if (existing != group.flags.end()) {
+          return &existing->second;
+        }
+        continue;
+      }
+      // Loaded from an image and shared before anything indexed it, so look through the actions
+      for (auto& argument : group.arguments) {
+        if (argument.argtype_ == argtypes::optional and std::find(argument.flags_.begin(), argument.flags_.end(), key) != argument.flags_.end()) {
+          return &argument;
+        }
+      }
+    }
+  }
+  return nullptr;
+}
+
+auto parsing::ParserCore::add_group(ArgumentParser& parser, std::string_view name) -> ActionGroup& {
+  auto& group = groups.emplace_back(parser, name);
+  all_groups.push_back(&group);
+  return group;
+}
+
+void parsing::ParserCore::adopt(ArgumentParser& parser) {
+  owner = &parser;
+  for (auto& group : groups) {
+    group.parent = &parser;
+  }
+}
@@ -0,0 +1,88 @@
+#include "parsing/parseresult.hpp"
+
+
+// ParseError definition
+auto parsing::ParseError::message() const -> std::string {
+  switch (code) {
+    case errors::none: {
+      return "";
+    }
+    case errors::unrecognized_optional: {
+      return "unrecognized optional argument: " + std::string(token);
+    }
+    case errors::already_provided: {
+      return "optional argument already provided: " + std::string(action->flags_string_);
+    }
+    case errors::unexpected_value: {
+      return std::string(action->flags_string_) + " does not take a value, but got: " + repr(std::string(token));
+    }
+    case errors::ambiguous_value: {
+      return std::string(action->flags_string_) + " expects exactly " + repr(action->min_nargs_) + " value(s), but got ambiguous value: " + repr(std::string(token));
+    }
+    case errors::missing_value: {
+      if (action->min_nargs_ == action->max_nargs_) {
+        return std::string(action->flags_string_) + " expects exactly " + repr(action->min_nargs_) + " value(s), but got " + repr(count);
+      }
+      return std::string(action->flags_string_) + " expects at least " + repr(action->min_nargs_) + " value(s), but got " + repr(count);
+    }
+    case errors::invalid_value: {
+      // Flags only take a value from outside the command line, where it's a boolean or a count
+      auto type = action->max_nargs_ != 0 ? action->valuetype_ : action->action_ == actions::count ? valuetypes::int64 : valuetypes::boolean;
+      return "argument " + std::string(action->flags_string_) + ": invalid " + std::string(name_of(type)) + " value: " + repr(std::string(token));
+    }
+    case errors::unsupported_action: {
+      return "not yet implemented: " + std::string(name_of(action->action_));
+    }
+    case errors::missing_required: {
+      return "missing required optional argument: " + std::string(action->flags_string_);
+    }
+    case errors::missing_positional: {
+      return "missing positional argument: " + std::string(action->flags_string_);
+    }
+    case errors::unrecognized_positional: {
+      return "unrecognized arguments: " + reprjoin(" ", std::vector<std::string>(extra.begin(), extra.end()));
+    }
+    case errors::unreadable_file: {
+      return "cannot read argument file: " + repr(std::string(token));
+    }
+    case errors::recursive_file: {
+      return "argument file includes itself: " + repr(std::string(token));
+    }
+    case errors::malformed_file: {
+      return "unterminated quote or escape in argument file: " + repr(std::string(token));
+    }
+    case errors::unreadable_input: {
+      return "cannot read " + std::string(action->flags_string_) + " from standard input";
+    }
+    case errors::malformed_line: {
+      return "unterminated quote or escape in command line";
+    }
+    case errors::missing_command: {
+      return "missing command, expected one of: " + join(", ", std::vector<std::string>(extra.begin(), extra.end()));
+    }
+    case errors::unknown_command: {
+      return "unknown command: " + repr(std::string(token));
+    }
+    case errors::ambiguous_option: {
+      return "ambiguous option: " + std::string(token) + " could match " + join(", ", std::vector<std::string>(extra.begin(), extra.end()));
+    }
+    case errors::unreadable_config: {
+      return "cannot read defaults file: " + repr(std::string(token));
+    }
+    case errors::malformed_config: {
+      return "malformed defaults file: " + repr(std::string(token)) + " (line " + repr(count) + ")";
+    }
+    case errors::unknown_key: {
+      return "unknown key in defaults file: " + repr(std::string(token)) + " (line " + repr(count) + ")";
+    }
+    default: {
+      return "unrecognized error";
+    }
+  }
+}
+
+
+// ParseResult definition
+parsing::ParseResult::operator bool() const {
+  return outcome == outcomes::parsed;
+}
@@ -0,0 +1,52 @@
+#include "parsing/records.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+
+// RecordReader definition
+auto parsing::RecordReader::each(const std::function<bool(std::string_view)>& sink) const -> bool {
+  std::vector<char> buffer(std::max<std::size_t>(chunk, 1));
+  std::string pending;
+
+  while (true) {
+    auto got = ::read(fd, buffer.data(), buffer.size());
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (got == 0) {
+      break;
+    }
+
+    const char* start = buffer.data();
+    const char* end = start + got;
+    while (start < end) {
+      auto* found = static_cast<const char*>(std::memchr(start, delimiter, static_cast<std::size_t>(end - start)));
+      if (found == nullptr) {
+        pending.append(start, end);
+        break;
+      }
+      std::string_view record(start, static_cast<std::size_t>(found - start));
+      if (not pending.empty()) {
+        pending.append(record);
+        record = pending;
+      }
+      if (not record.empty() and not sink(record)) {
+        return true;
+      }
+      pending.clear();
+      start = found + 1;
+    }
+  }
+
+  // The last record doesn't have to be terminated
+  if (not pending.empty()) {
+    sink(pending);
+  }
+  return true;
+}
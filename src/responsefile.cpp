@@ -0,0 +1,153 @@
+#include "parsing/responsefile.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// MappedFile definition
+parsing::MappedFile::MappedFile(MappedFile&& other) noexcept
+  : data(std::exchange(other.data, nullptr))
+  , size(std::exchange(other.size, 0))
+  , device(other.device)
+  , inode(other.inode)
+{}
+
+parsing::MappedFile& parsing::MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    if (data != nullptr) {
+      munmap(const_cast<char*>(data), size);
+    }
+    data = std::exchange(other.data, nullptr);
+    size = std::exchange(other.size, 0);
+    device = other.device;
+    inode = other.inode;
+  }
+  return *this;
+}
+
+parsing::MappedFile::~MappedFile() {
+  if (data != nullptr) {
+    munmap(const_cast<char*>(data), size);
+  }
+}
+
+auto parsing::MappedFile::open(const std::string& path) -> bool {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0 or not S_ISREG(info.st_mode)) {
+    close(fd);
+    return false;
+  }
+  device = static_cast<std::uint64_t>(info.st_dev);
+  inode = static_cast<std::uint64_t>(info.st_ino);
+  size = static_cast<std::size_t>(info.st_size);
+  if (size > 0) {
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close(fd);
+      size = 0;
+      return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped);
+  }
+  close(fd);
+  return true;
+}
+
+auto parsing::MappedFile::view() const -> std::string_view {
+  return data == nullptr ? std::string_view() : std::string_view(data, size);
+}
+
+
+// ResponseFiles definition
+auto parsing::ResponseFiles::expand(ArgSpan args, std::string_view prefix_chars, rspmodes mode, std::vector<std::string_view>& out, ParseError& error) -> bool {
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> stack;
+  out.reserve(args.size());
+  for (std::size_t ix = 0; ix < args.size(); ++ix) {
+    auto arg = args[ix];
+    if (arg.empty() or prefix_chars.find(arg.front()) == prefix_chars.npos) {
+      out.push_back(arg);
+      continue;
+    }
+    if (not _expand_file(arg.substr(1), prefix_chars, mode, stack, out, error)) {
+      error.position = static_cast<std::ptrdiff_t>(ix);
+      return false;
+    }
+  }
+  return true;
+}
+
+auto parsing::ResponseFiles::_expand_file(std::string_view path, std::string_view prefix_chars, rspmodes mode, std::vector<std::pair<std::uint64_t, std::uint64_t>>& stack, std::vector<std::string_view>& out, ParseError& error) -> bool {
+  MappedFile file;
+  if (not file.open(std::string(path))) {
+    error.code = errors::unreadable_file;
+    error.token = path;
+    return false;
+  }
+  std::pair<std::uint64_t, std::uint64_t> identity {file.device, file.inode};
+  if (std::find(stack.begin(), stack.end(), identity) != stack.end()) {
+    error.code = errors::recursive_file;
+    error.token = path;
+    return false;
+  }
+  files.push_back(std::move(file));
+  auto text = files.back().view();
+  stack.push_back(identity);
+
+  auto emit = [&](std::string_view token) {
+    if (not token.empty() and prefix_chars.find(token.front()) != prefix_chars.npos) {
+      return _expand_file(token.substr(1), prefix_chars, mode, stack, out, error);
+    }
+    out.push_back(token);
+    return true;
+  };
+
+  switch (mode) {
+    case rspmodes::newline:
+    case rspmodes::nul: {
+      char separator = mode == rspmodes::nul ? '\0' : '\n';
+      std::size_t start = 0;
+      while (start < text.size()) {
+        auto end = text.find(separator, start);
+        if (end == text.npos) {
+          end = text.size();
+        }
+        auto token = text.substr(start, end - start);
+        if (mode == rspmodes::newline and not token.empty() and token.back() == '\r') {
+          token.remove_suffix(1);
+        }
+        if (not token.empty() and not emit(token)) {
+          return false;
+        }
+        start = end + 1;
+      }
+      break;
+    }
+    case rspmodes::shell: {
+      ShellTokenizer tokenizer(text);
+      std::string_view token;
+      while (tokenizer.next(token, owned)) {
+        if (not emit(token)) {
+          return false;
+        }
+      }
+      if (tokenizer.failed) {
+        error.code = errors::malformed_file;
+        error.token = path;
+        return false;
+      }
+      break;
+    }
+  }
+
+  stack.pop_back();
+  return true;
+}
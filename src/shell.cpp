@@ -0,0 +1,164 @@
+#include "parsing/shell.hpp"
+
+
+namespace {
+  auto is_space(char c) -> bool {
+    return c == ' ' or c == '\t' or c == '\n' or c == '\r' or c == '\v' or c == '\f';
+  }
+
+  auto is_special(char c, bool expanding) -> bool {
+    return is_space(c) or c == '\'' or c == '"' or c == '\\' or (expanding and c == '$');
+  }
+
+  auto is_name(char c, bool first) -> bool {
+    return c == '_' or (c >= 'A' and c <= 'Z') or (c >= 'a' and c <= 'z') or (not first and c >= '0' and c <= '9');
+  }
+}
+
+
+// ShellTokenizer definition
+parsing::ShellTokenizer::ShellTokenizer(std::string_view text, expander expand) : text(text), expand(std::move(expand)) {}
+
+auto parsing::ShellTokenizer::next(std::string_view& token, std::pmr::forward_list<std::pmr::string>& owned) -> bool {
+  const std::size_t size = text.size();
+  const bool expanding = static_cast<bool>(expand);
+
+  // Skip blanks and comments
+  while (pos < size) {
+    if (is_space(text[pos])) {
+      ++pos;
+    }
+    else if (text[pos] == '#') {
+      while (pos < size and text[pos] != '\n') {
+        ++pos;
+      }
+    }
+    else if (text[pos] == '\\' and pos + 1 < size and text[pos + 1] == '\n') {
+      pos += 2;
+    }
+    else {
+      break;
+    }
+  }
+  if (pos >= size or failed) {
+    return false;
+  }
+
+  std::size_t start = pos;
+
+  // Plain word: nothing to undo, so hand back a view
+  while (pos < size and not is_special(text[pos], expanding)) {
+    ++pos;
+  }
+  if (pos == size or is_space(text[pos])) {
+    token = text.substr(start, pos - start);
+    return true;
+  }
+
+  // A word that is exactly one quoted span is still a view, as long as nothing inside needs undoing
+  if (pos == start and (text[pos] == '\'' or text[pos] == '"')) {
+    char quote = text[pos];
+    auto close = text.find(quote, pos + 1);
+    if (close != text.npos and (close + 1 == size or is_space(text[close + 1]))) {
+      auto inner = text.substr(pos + 1, close - pos - 1);
+      if (quote == '\'' or (inner.find('\\') == inner.npos and not (expanding and inner.find('$') != inner.npos))) {
+        token = inner;
+        pos = close + 1;
+        return true;
+      }
+    }
+  }
+
+  // $NAME or ${NAME} at `pos`; anything else leaves the '$' as it is
+  bool expanded = false;
+  auto substitute = [&](std::pmr::string& word) {
+    std::size_t name_start = pos + 1;
+    bool braced = name_start < size and text[name_start] == '{';
+    if (braced) {
+      ++name_start;
+    }
+    std::size_t name_end = name_start;
+    while (name_end < size and is_name(text[name_end], name_end == name_start)) {
+      ++name_end;
+    }
+    if (name_end == name_start or (braced and (name_end >= size or text[name_end] != '}'))) {
+      word.push_back('$');
+      ++pos;
+      return;
+    }
+    word.append(expand(text.substr(name_start, name_end - name_start)));
+    expanded = true;
+    pos = braced ? name_end + 1 : name_end;
+  };
+
+  // Everything else gets rebuilt
+  std::pmr::string word(text.substr(start, pos - start), owned.get_allocator().resource());
+  bool quoted = false;
+  while (pos < size and not is_space(text[pos])) {
+    char c = text[pos];
+    if (c == '\'') {
+      auto close = text.find('\'', pos + 1);
+      if (close == text.npos) {
+        failed = true;
+        return false;
+      }
+      word.append(text.substr(pos + 1, close - pos - 1));
+      pos = close + 1;
+      quoted = true;
+    }
+    else if (c == '"') {
+      ++pos;
+      while (pos < size and text[pos] != '"') {
+        if (text[pos] == '\\' and pos + 1 < size) {
+          char escaped = text[pos + 1];
+          if (escaped == '\n') {
+            pos += 2;
+            continue;
+          }
+          if (escaped == '\\' or escaped == '"' or escaped == '$' or escaped == '`') {
+            word.push_back(escaped);
+            pos += 2;
+            continue;
+          }
+        }
+        if (expanding and text[pos] == '$') {
+          substitute(word);
+          continue;
+        }
+        word.push_back(text[pos]);
+        ++pos;
+      }
+      if (pos >= size) {
+        failed = true;
+        return false;
+      }
+      ++pos;
+      quoted = true;
+    }
+    else if (c == '\\') {
+      if (pos + 1 >= size) {
+        failed = true;
+        return false;
+      }
+      if (text[pos + 1] != '\n') {
+        word.push_back(text[pos + 1]);
+      }
+      pos += 2;
+    }
+    else if (expanding and c == '$') {
+      substitute(word);
+    }
+    else {
+      word.push_back(c);
+      ++pos;
+    }
+  }
+
+  // Like the shell, an unquoted expansion that comes out empty isn't a word at all
+  if (word.empty() and expanded and not quoted) {
+    return next(token, owned);
+  }
+  owned.push_front(std::move(word));
+  token = owned.front();
+  return true;
+}
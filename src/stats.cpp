@@ -0,0 +1,111 @@
+#include "parsing/stats.hpp"
+
+#if PARSING_STATS
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+
+// CountingResource definition
+auto parsing::CountingResource::do_allocate(std::size_t bytes, std::size_t alignment) -> void* {
+  ++allocations;
+  this->bytes += bytes;
+  return upstream->allocate(bytes, alignment);
+}
+
+void parsing::CountingResource::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) {
+  upstream->deallocate(pointer, bytes, alignment);
+}
+
+auto parsing::CountingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool {
+  return this == &other;
+}
+
+
+// ParseStats definition
+auto parsing::ParseStats::now() -> std::uint64_t {
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+auto parsing::ParseStats::current_thread() -> std::uint32_t {
+  static std::atomic<std::uint32_t> next {0};
+  thread_local std::uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+void parsing::ParseStats::enter(phases phase) {
+  auto time = now();
+  if (open) {
+    record(current, started, time);
+  }
+  open = true;
+  current = phase;
+  started = time;
+}
+
+void parsing::ParseStats::record(phases phase, std::uint64_t start_ns, std::uint64_t end_ns) {
+  phase_ns[static_cast<std::size_t>(phase)] += end_ns - start_ns;
+  if (span_count < spans.size()) {
+    spans[span_count++] = {phase, start_ns, end_ns - start_ns};
+  }
+}
+
+void parsing::ParseStats::finish(const CountingResource& counter) {
+  if (open) {
+    record(current, started, now());
+    open = false;
+  }
+  allocations = counter.allocations;
+  bytes = counter.bytes;
+}
+
+auto parsing::ParseStats::total_ns() const -> std::uint64_t {
+  std::uint64_t total = 0;
+  for (auto ns : phase_ns) {
+    total += ns;
+  }
+  return total;
+}
+
+auto parsing::ParseStats::chrome_trace() const -> std::string {
+  return parsing::chrome_trace({this});
+}
+
+auto parsing::chrome_trace(const std::vector<const ParseStats*>& runs) -> std::string {
+  // Trace timestamps are microseconds; keep the nanoseconds as decimals
+  auto micros = [](std::uint64_t ns) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000), static_cast<unsigned long long>(ns % 1000));
+    return std::string(text);
+  };
+
+  std::string out = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  bool first = true;
+  auto event = [&](std::string_view name, std::uint32_t thread, std::uint64_t start, std::uint64_t duration, const std::string& args) {
+    out += first ? "\n" : ",\n";
+    first = false;
+    out += "  {\"name\": \"" + std::string(name) + "\", \"cat\": \"parsing\", \"ph\": \"X\", \"pid\": 1, \"tid\": " + std::to_string(thread);
+    out += ", \"ts\": " + micros(start) + ", \"dur\": " + micros(duration) + args + "}";
+  };
+  for (const auto* run : runs) {
+    if (run == nullptr or run->span_count == 0) {
+      continue;
+    }
+    auto start = run->spans[0].start_ns;
+    auto end = start;
+    for (std::size_t ix = 0; ix < run->span_count; ++ix) {
+      start = std::min(start, run->spans[ix].start_ns);
+      end = std::max(end, run->spans[ix].start_ns + run->spans[ix].duration_ns);
+    }
+    event("parse", run->thread, start, end - start, ", \"args\": {\"tokens\": " + std::to_string(run->tokens) + ", \"lookups\": " + std::to_string(run->lookups) + ", \"allocations\": " + std::to_string(run->allocations) + ", \"bytes\": " + std::to_string(run->bytes) + "}");
+    for (std::size_t ix = 0; ix < run->span_count; ++ix) {
+      const auto& span = run->spans[ix];
+      event(name_of(span.phase), run->thread, span.start_ns, span.duration_ns, "");
+    }
+  }
+  out += "\n]}\n";
+  return out;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "parsing/subparsers.hpp"
+
+
+// Subparsers definition
+auto parsing::Subparsers::add_parser(const std::string& name, factory build, const std::string& help) -> Subparsers& {
+  if (not text) {
+    text = std::make_shared<std::deque<std::string>>();
+  }
+  std::string_view kept_help;
+  if (not help.empty()) {
+    kept_help = text->emplace_back(help);
+  }
+  return _add(text->emplace_back(name), std::move(build), kept_help);
+}
+
+auto parsing::Subparsers::_add(std::string_view name, factory build, std::string_view help) -> Subparsers& {
+  if (name.empty() or name.front() == '-') {
+    error("Subparsers", "command names cannot be empty or start with '-': " + repr(std::string(name)));
+    std::quick_exit(1);
+  }
+  entries.push_back(Entry{name, help, std::move(build)});
+  return *this;
+}
+
+void parsing::Subparsers::index() {
+  order.resize(entries.size());
+  for (std::size_t ix = 0; ix < order.size(); ++ix) {
+    order[ix] = static_cast<std::uint32_t>(ix);
+  }
+  // Stable, so of two entries with one name the first added is the one reported as a duplicate
+  std::stable_sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b){ return entries[a].name < entries[b].name; });
+  auto same = std::adjacent_find(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b){ return entries[a].name == entries[b].name; });
+  if (same != order.end()) {
+    error("Subparsers", "duplicate command: " + repr(std::string(entries[*same].name)));
+    std::quick_exit(1);
+  }
+}
+
+auto parsing::Subparsers::find(std::string_view name) const -> const Entry* {
+  if (order.size() != entries.size()) {
+    for (auto& entry : entries) {
+      if (entry.name == name) {
+        return &entry;
+      }
+    }
+    return nullptr;
+  }
+  auto it = std::lower_bound(order.begin(), order.end(), name, [this](std::uint32_t ix, std::string_view value){ return entries[ix].name < value; });
+  if (it == order.end() or entries[*it].name != name) {
+    return nullptr;
+  }
+  return &entries[*it];
+}
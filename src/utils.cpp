@@ -1,48 +1,147 @@
 #include "parsing/utils.hpp"
 
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
 
 // DEFINITIONS
 
-std::locale parsing::default_locale = std::locale("");
-
-std::unordered_map<std::size_t, std::string> parsing::level_colors = {
-  {50, "\x1b[41m"},
-  {40, "\x1b[31m"},
-  {30, "\x1b[33m"},
-  {20, "\x1b[32m"},
-  {10, "\x1b[36m"},
-  {0,  "\x1b[00m"},
-};
-
-std::unordered_map<std::size_t, std::string> parsing::level_names = {
-  {50, "critical"},
-  {40, "error"},
-  {30, "warning"},
-  {20, "info"},
-  {10, "debug"},
-};
-
-std::unordered_map<parsing::actions, std::string> parsing::action_mapping = {
-  {actions::store, "store"},
-  {actions::store_true, "store_true"},
-  {actions::store_false, "store_false"},
-  {actions::store_const, "store_const"},
-  {actions::append_const, "append_const"},
-  {actions::append, "append"},
-  {actions::extend, "extend"},
-  {actions::count, "count"},
-  {actions::help, "help"},
-  {actions::version, "version"},
-};
-
-std::unordered_map<parsing::argtypes, std::string> parsing::argtype_mapping = {
-  {argtypes::positional, "positional"},
-  {argtypes::optional, "optional"},
-};
+namespace {
+  // from_chars over the whole view; trailing junk counts as failure
+  template <typename T>
+  auto parse_whole(std::string_view text, T& out) -> bool {
+    if (text.size() > 1 and text.front() == '+' and text[1] != '-') {
+      text.remove_prefix(1);
+    }
+    const char* last = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), last, out);
+    return ec == std::errc() and ptr == last;
+  }
+
+  // Splits "64KiB" or "-10ms" into its integer part and its unit
+  auto split_unit(std::string_view text) -> std::pair<std::string_view, std::string_view> {
+    std::size_t ix = (not text.empty() and (text.front() == '-' or text.front() == '+')) ? 1 : 0;
+    while (ix < text.size() and text[ix] >= '0' and text[ix] <= '9') {
+      ++ix;
+    }
+    return {text.substr(0, ix), text.substr(ix)};
+  }
+
+  auto scale(std::uint64_t value, std::uint64_t factor, std::uint64_t& out) -> bool {
+    if (factor != 0 and value > UINT64_MAX / factor) {
+      return false;
+    }
+    out = value * factor;
+    return true;
+  }
+
+  auto size_factor(std::string_view unit, std::uint64_t& out) -> bool {
+    if (unit.empty() or unit == "B") {
+      out = 1;
+      return true;
+    }
+    static constexpr std::string_view prefixes = "KMGTPE";
+    auto power = prefixes.find(static_cast<char>(std::toupper(static_cast<unsigned char>(unit.front()))));
+    if (power == prefixes.npos) {
+      return false;
+    }
+    unit.remove_prefix(1);
+    std::uint64_t base = 0;
+    if (unit.empty() or unit == "i" or unit == "iB") {
+      base = 1024;
+    }
+    else if (unit == "B") {
+      base = 1000;
+    }
+    else {
+      return false;
+    }
+    out = 1;
+    for (std::size_t ix = 0; ix <= power; ++ix) {
+      out *= base;
+    }
+    return true;
+  }
+
+  auto duration_factor(std::string_view unit, std::int64_t& out) -> bool {
+    if (unit == "ns") { out = 1; }
+    else if (unit == "us") { out = 1000; }
+    else if (unit == "ms") { out = 1000 * 1000; }
+    else if (unit.empty() or unit == "s") { out = 1000 * 1000 * 1000; }
+    else if (unit == "m") { out = INT64_C(60) * 1000 * 1000 * 1000; }
+    else if (unit == "h") { out = INT64_C(3600) * 1000 * 1000 * 1000; }
+    else { return false; }
+    return true;
+  }
+
+  // Narrows a stored value to what an accessor returns, throwing std::out_of_range rather than
+  // wrapping when it doesn't fit
+  template <typename T, typename V>
+  auto checked_cast(V value) -> T {
+    using limits = std::numeric_limits<T>;
+    if constexpr (std::is_same_v<T, bool> or std::is_floating_point_v<T>) {
+      return static_cast<T>(value);
+    }
+    else if constexpr (std::is_floating_point_v<V>) {
+      // Checked as a double, since converting one that's out of range is undefined (and NaN
+      // fails both tests)
+      auto bound = std::ldexp(1.0, limits::digits);
+      if (not (value < bound and (limits::is_signed ? value >= -bound : value > -1.0))) {
+        throw std::out_of_range("value out of range");
+      }
+      return static_cast<T>(value);
+    }
+    else if constexpr (std::is_signed_v<V>) {
+      if (value < 0 ? (not limits::is_signed or value < static_cast<std::int64_t>(limits::min())) : static_cast<std::uint64_t>(value) > static_cast<std::uint64_t>(limits::max())) {
+        throw std::out_of_range("value out of range");
+      }
+      return static_cast<T>(value);
+    }
+    else {
+      if (value > static_cast<std::uint64_t>(limits::max())) {
+        throw std::out_of_range("value out of range");
+      }
+      return static_cast<T>(value);
+    }
+  }
+
+  template <typename T>
+  auto cast_value(parsing::valuetypes type, const parsing::Value& value) -> T {
+    switch (type) {
+      case parsing::valuetypes::float64: {
+        return checked_cast<T>(value.f);
+      }
+      case parsing::valuetypes::uint64:
+      case parsing::valuetypes::boolean:
+      case parsing::valuetypes::size: {
+        return checked_cast<T>(value.u);
+      }
+      default: {
+        return checked_cast<T>(value.i);
+      }
+    }
+  }
+
+  // Reads a value converted during the parse, or converts on the spot for untyped arguments
+  template <typename T>
+  auto typed_at(const parsing::Result& result, std::size_t ix, parsing::valuetypes fallback, const char* what) -> T {
+    if (result.type != parsing::valuetypes::string) {
+      return cast_value<T>(result.type, result.typed.at(ix));
+    }
+    parsing::Value value{};
+    if (not parsing::convert(fallback, result.values.at(ix), value)) {
+      throw std::invalid_argument(what);
+    }
+    return cast_value<T>(fallback, value);
+  }
+}
 
 // Definitions
 void parsing::log(std::size_t level, const std::string& name, const std::string& msg) {
-  std::cerr << level_colors[level] << "[" << name << " " << level_names[level] << "]" << level_colors[0] << ": " << msg << '\n';
+  auto ix = std::min<std::size_t>(level / 10, level_names.size() - 1);
+  std::cerr << level_colors[ix] << "[" << name << " " << level_names[ix] << "]" << level_colors[0] << ": " << msg << '\n';
   std::cerr.flush();
 }
 
@@ -89,8 +188,10 @@ auto parsing::repr(const std::string& value) -> std::string {
   if (value.find('"') == value.npos) {
     return "\"" + value + "\"";
   }
-  error("repr", "internal util function not sophisticated enough to handle strings containing all of: single quotes, double quotes, and spaces");
-  std::quick_exit(1);
+  // All three present, so escape; this runs on user input while formatting errors and can't exit
+  std::ostringstream oss;
+  oss << std::quoted(value);
+  return oss.str();
 }
 
 auto parsing::join(const std::string& separator, const std::vector<std::string>& values) -> std::string {
@@ -126,7 +227,7 @@ auto parsing::reprjoin(const std::string& separator, const std::deque<std::strin
   return result;
 }
 
-auto parsing::is_number(const std::string& value) -> bool {
+auto parsing::is_number(std::string_view value) -> bool {
   for (const auto& i : value) {
     if (!std::isdigit(i)) {
       return false;
@@ -141,10 +242,28 @@ auto parsing::sorted_by_size(const std::vector<std::string>& values) -> std::vec
   return vec;
 }
 
+auto parsing::default_locale() -> const std::locale& {
+  static const std::locale locale = []{
+    try {
+      return std::locale("");
+    }
+    catch (const std::runtime_error&) {
+      return std::locale::classic();
+    }
+  }();
+  return locale;
+}
+
 auto parsing::to_upper(const std::string& value) -> std::string {
   std::string other = value;
   for (auto& c: other) {
-    c = std::toupper(c, default_locale);
+    // ASCII covers every dest anyone writes, and never needs the locale
+    if (c >= 'a' and c <= 'z') {
+      c = static_cast<char>(c - 'a' + 'A');
+    }
+    else if (static_cast<unsigned char>(c) >= 0x80) {
+      c = std::toupper(c, default_locale());
+    }
   }
   return other;
 }
@@ -183,16 +302,83 @@ auto parsing::get_required(const std::vector<std::string>& values) -> bool {
   return (get_argtype(values) == argtypes::positional) ? true : false;
 }
 
+auto parsing::get_valuetype(const std::string& value, valuetypes& out) -> bool {
+  if (value == "string" or value == "str") { out = valuetypes::string; }
+  else if (value == "int" or value == "int64") { out = valuetypes::int64; }
+  else if (value == "uint" or value == "uint64") { out = valuetypes::uint64; }
+  else if (value == "float" or value == "double") { out = valuetypes::float64; }
+  else if (value == "bool") { out = valuetypes::boolean; }
+  else if (value == "size") { out = valuetypes::size; }
+  else if (value == "duration") { out = valuetypes::duration; }
+  else { return false; }
+  return true;
+}
+
+auto parsing::convert(valuetypes type, std::string_view text, Value& out) -> bool {
+  switch (type) {
+    case valuetypes::int64: {
+      return parse_whole(text, out.i);
+    }
+    case valuetypes::uint64: {
+      return parse_whole(text, out.u);
+    }
+    case valuetypes::float64: {
+      return parse_whole(text, out.f);
+    }
+    case valuetypes::boolean: {
+      if (text == "true" or text == "yes" or text == "on" or text == "1") {
+        out.u = 1;
+        return true;
+      }
+      if (text == "false" or text == "no" or text == "off" or text == "0") {
+        out.u = 0;
+        return true;
+      }
+      return false;
+    }
+    case valuetypes::size: {
+      auto [number, unit] = split_unit(text);
+      std::uint64_t value = 0;
+      std::uint64_t factor = 0;
+      return parse_whole(number, value) and size_factor(unit, factor) and scale(value, factor, out.u);
+    }
+    case valuetypes::duration: {
+      auto [number, unit] = split_unit(text);
+      std::int64_t value = 0;
+      std::int64_t factor = 0;
+      if (not parse_whole(number, value) or not duration_factor(unit, factor)) {
+        return false;
+      }
+      if (value > INT64_MAX / factor or value < INT64_MIN / factor) {
+        return false;
+      }
+      out.i = value * factor;
+      return true;
+    }
+    default: {
+      return true;
+    }
+  }
+}
+
 
 // Result definition
-void parsing::Result::append(const std::string& value) {
+parsing::Result::Result(const allocator_type& alloc) : values(alloc), typed(alloc), starts(alloc) {}
+
+parsing::Result::Result(const Result& other, const allocator_type& alloc) : values(other.values, alloc), typed(other.typed, alloc), starts(other.starts, alloc), type(other.type) {}
+
+void parsing::Result::append(std::string_view value) {
   values.emplace_back(value);
 }
 
-void parsing::Result::prepend(const std::string& value) {
+void parsing::Result::prepend(std::string_view value) {
   values.emplace(values.begin(), value);
 }
 
+void parsing::Result::begin_occurrence() {
+  starts.push_back(values.size());
+}
+
 auto parsing::Result::size() -> std::size_t {
   return values.size();
 }
@@ -203,12 +389,18 @@ auto parsing::Result::empty() -> bool {
 
 void parsing::Result::clear() {
   values.clear();
+  typed.clear();
+  starts.clear();
+  type = valuetypes::string;
 }
 
 parsing::Result::operator bool() const {
   if (values.size() == 0) {
     return false;
   }
+  if (type != valuetypes::string) {
+    return cast_value<bool>(type, typed.at(0));
+  }
   if (values.at(0) == "true") {
     return true;
   }
@@ -222,34 +414,28 @@ parsing::Result::operator int() const {
   if (values.size() == 0) {
     return 0;
   }
-  if (!is_number(values.at(0))) {
-    throw std::invalid_argument("not an integer");
-  }
-  return std::stoi(values.at(0));
+  return typed_at<int>(*this, 0, valuetypes::int64, "not an integer");
 }
 
 parsing::Result::operator std::string() const {
   if (values.size() == 0) {
     return "";
   }
-  return values.at(0);
+  return std::string(values.at(0));
 }
 
 parsing::Result::operator std::size_t() const {
   if (values.size() == 0) {
     return 0;
   }
-  if (!is_number(values.at(0))) {
-    throw std::invalid_argument("not an integer");
-  }
-  return std::stoul(values.at(0));
+  return typed_at<std::size_t>(*this, 0, valuetypes::uint64, "not an integer");
 }
 
 parsing::Result::operator std::vector<std::string>() const {
   if (values.size() == 0) {
     return {};
   }
-  return values;
+  return std::vector<std::string>(values.begin(), values.end());
 }
 
 parsing::Result::operator std::vector<int>() const {
@@ -257,11 +443,9 @@ parsing::Result::operator std::vector<int>() const {
     return {};
   }
   std::vector<int> vec;
-  for (const auto& item : values) {
-    if (!is_number(item)) {
-      throw std::invalid_argument("not all items were integers");
-    }
-    vec.emplace_back(std::stoul(item));
+  vec.reserve(values.size());
+  for (std::size_t ix = 0; ix < values.size(); ++ix) {
+    vec.emplace_back(typed_at<int>(*this, ix, valuetypes::int64, "not all items were integers"));
   }
   return vec;
 }
@@ -293,3 +477,84 @@ auto parsing::Result::as_strings() const -> std::vector<std::string> {
 auto parsing::Result::as_ints() const -> std::vector<int> {
   return std::vector<int>(*this);
 }
+
+auto parsing::Result::as_int64() const -> std::int64_t {
+  if (values.size() == 0) {
+    return 0;
+  }
+  return typed_at<std::int64_t>(*this, 0, valuetypes::int64, "not an integer");
+}
+
+auto parsing::Result::as_uint64() const -> std::uint64_t {
+  if (values.size() == 0) {
+    return 0;
+  }
+  return typed_at<std::uint64_t>(*this, 0, valuetypes::uint64, "not an unsigned integer");
+}
+
+auto parsing::Result::as_double() const -> double {
+  if (values.size() == 0) {
+    return 0.0;
+  }
+  return typed_at<double>(*this, 0, valuetypes::float64, "not a number");
+}
+
+auto parsing::Result::as_duration() const -> std::chrono::nanoseconds {
+  if (values.size() == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  return std::chrono::nanoseconds(typed_at<std::int64_t>(*this, 0, valuetypes::duration, "not a duration"));
+}
+
+auto parsing::Result::as_view() const -> std::string_view {
+  if (values.size() == 0) {
+    return {};
+  }
+  return values.at(0);
+}
+
+auto parsing::Result::as_views() const -> const std::pmr::vector<std::string_view>& {
+  return values;
+}
+
+auto parsing::Result::occurrences() const -> Occurrences {
+  return {this};
+}
+
+auto parsing::Result::occurrence(std::size_t ix) const -> Occurrence {
+  if (ix >= occurrence_count()) {
+    throw std::out_of_range("no such occurrence");
+  }
+  auto first = starts.empty() ? 0 : starts[ix];
+  auto last = ix + 1 < starts.size() ? starts[ix + 1] : values.size();
+  return {values.data() + first, values.data() + last, first};
+}
+
+auto parsing::Result::occurrence_count() const -> std::size_t {
+  if (starts.empty()) {
+    return values.empty() ? 0 : 1;
+  }
+  return starts.size();
+}
+
+
+// Occurrences definition
+auto parsing::Occurrences::iterator::operator*() const -> Occurrence {
+  return result->occurrence(ix);
+}
+
+auto parsing::Occurrences::begin() const -> iterator {
+  return {result, 0};
+}
+
+auto parsing::Occurrences::end() const -> iterator {
+  return {result, result->occurrence_count()};
+}
+
+auto parsing::Occurrences::size() const -> std::size_t {
+  return result->occurrence_count();
+}
+
+auto parsing::Occurrences::operator[](std::size_t ix) const -> Occurrence {
+  return result->occurrence(ix);
+}
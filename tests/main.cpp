@@ -1,13 +1,67 @@
+#include <fstream>
+
+#include <unistd.h>
+
 #include "parsing.hpp"
 #include "./testformatter.hpp"
 
 
 
 void test_single_positional_value();
+void test_optional_values();
+void test_argv_views();
+void test_namespace_handles();
+void test_typed_values();
+void test_lexer_tokens();
+void test_static_spec();
+void test_try_parse();
+void test_response_files();
+void test_streamed_positionals();
+void test_parse_batch();
+void test_parse_line();
+void test_subparsers();
+void test_completion();
+void test_static_tables();
+void test_abbreviations();
+void test_short_clusters();
+void test_env_fallback();
+void test_defaults_files();
+void test_parser_images();
+void test_parse_stats();
+void test_pmr_allocation();
+void test_line_resources();
+void test_shared_cores();
+void test_positional_layout();
+void test_append_occurrences();
 
 
 int main() {
   test_single_positional_value();
+  test_optional_values();
+  test_argv_views();
+  test_namespace_handles();
+  test_typed_values();
+  test_lexer_tokens();
+  test_static_spec();
+  test_try_parse();
+  test_response_files();
+  test_streamed_positionals();
+  test_parse_batch();
+  test_parse_line();
+  test_subparsers();
+  test_completion();
+  test_static_tables();
+  test_abbreviations();
+  test_short_clusters();
+  test_env_fallback();
+  test_defaults_files();
+  test_parser_images();
+  test_parse_stats();
+  test_pmr_allocation();
+  test_line_resources();
+  test_shared_cores();
+  test_positional_layout();
+  test_append_occurrences();
 }
 
 
@@ -116,3 +170,1056 @@ void test_single_positional_value() {
   }
   tf.show_passed(parser.m.name);
 }
+
+
+void test_optional_values() {
+  std::deque<std::string> separate = {"--output", "out.txt", "-j", "4"};
+  std::deque<std::string> joined = {"--output=out.txt", "-j", "4"};
+
+  TestFormatter tf(24);
+  std::unordered_map<std::string, parsing::Result> args;
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("optional:lazy");
+  parser.add_argument({"--output", "-o"});
+  parser.add_argument({"--jobs", "-j"});
+  args = parser.parse_args(separate);
+  if (args["output"].as_string() != "out.txt" or args["jobs"].as_int() != 4) {
+    tf.show_failure(parser.m.name, separate);
+  }
+  tf.show_passed(parser.m.name);
+
+  parser = parsing::ArgumentParser::create_parser("optional:compiled");
+  parser.add_argument({"--output", "-o"});
+  parser.add_argument({"--jobs", "-j"});
+  parser.compile();
+  args = parser.parse_args(joined);
+  if (args["output"].as_string() != "out.txt" or args["jobs"].as_int() != 4) {
+    tf.show_failure(parser.m.name, joined);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+
+void test_argv_views() {
+  char prog[] = "prog";
+  char flag[] = "--output=out.txt";
+  char source[] = "in.txt";
+  char* argv[] = {prog, flag, source};
+  std::deque<std::string> expected = {"prog", "--output=out.txt", "in.txt"};
+
+  TestFormatter tf(24);
+  std::unordered_map<std::string, parsing::Result> args;
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("argv:views");
+  parser.add_argument("program");
+  parser.add_argument("source");
+  parser.add_argument("--output");
+  args = parser.parse_args(3, argv);
+  if (args["source"].as_view().data() != source or args["output"].as_view().data() != flag + 9 or args["output"].as_string() != "out.txt") {
+    tf.show_failure(parser.m.name, expected);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+
+void test_namespace_handles() {
+  std::deque<std::string> values = {"--jobs", "8", "--quiet", "src"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("namespace:handles");
+  auto& source = parser.add_argument("source");
+  auto& jobs = parser.add_argument({"--jobs", "-j"});
+  auto& quiet = parser.add_argument("--quiet").action(parsing::actions::store_true).dest("verbose");
+  auto& loud = parser.add_argument("--loud").action(parsing::actions::store_false).dest("verbose");
+  parser.compile();
+  parsing::Namespace args = parser.parse_args(values);
+  if (args[source].as_string() != "src" or args[jobs].as_int() != 8 or args["jobs"].as_int() != 8) {
+    tf.show_failure(parser.m.name, values);
+  }
+  if (&args[quiet] != &args[loud] or args["verbose"].as_bool() != true or args.count("missing") != 0) {
+    tf.show_failure(parser.m.name + ":shared", values);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+
+void test_typed_values() {
+  std::deque<std::string> values = {"--offset", "-12", "--limit", "64KiB", "--timeout", "250ms", "--ratio", "0.5", "--force", "yes"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("typed");
+  parser.add_argument("--offset").type("int");
+  parser.add_argument("--limit").type("size");
+  parser.add_argument("--timeout").type("duration");
+  parser.add_argument("--ratio").type("double");
+  parser.add_argument("--force").type("bool");
+  parser.add_argument("--retries").type("uint").default_value("3");
+  parsing::Namespace args = parser.parse_args(values);
+  if (args["offset"].as_int() != -12 or args["limit"].as_size_t() != 65536 or args["retries"].as_uint64() != 3) {
+    tf.show_failure(parser.m.name + ":ints", values);
+  }
+  if (args["timeout"].as_duration() != std::chrono::milliseconds(250) or args["ratio"].as_double() != 0.5 or not args["force"].as_bool()) {
+    tf.show_failure(parser.m.name + ":others", values);
+  }
+  // Nothing narrows silently: what doesn't fit the accessor's type throws
+  std::deque<std::string> wide = {"--offset", "-12", "--limit", "3000000000", "--ratio", "1e30"};
+  auto checked = parser.parse_args(wide);
+  auto throws = [](auto read) {
+    try {
+      read();
+    }
+    catch (const std::out_of_range&) {
+      return true;
+    }
+    return false;
+  };
+  if (checked["limit"].as_uint64() != 3000000000u or not throws([&]{ return checked["limit"].as_int(); }) or not throws([&]{ return checked["offset"].as_size_t(); })
+      or not throws([&]{ return checked["ratio"].as_int(); }) or not throws([&]{ return checked["ratio"].as_uint64(); }) or checked["offset"].as_int() != -12) {
+    tf.show_failure(parser.m.name + ":range", wide);
+  }
+  std::deque<std::string> big = {"--offset", "5000000000"};
+  checked = parser.parse_args(big);
+  if (checked["offset"].as_int64() != 5000000000 or not throws([&]{ return checked["offset"].as_int(); }) or not throws([&]{ return checked["offset"].as_ints(); })) {
+    tf.show_failure(parser.m.name + ":range", big);
+  }
+  // A copy keeps the converted values, not just their text
+  parsing::Namespace copy = args;
+  parsing::Namespace assigned;
+  assigned = args;
+  for (const auto* copied : {&copy, &assigned}) {
+    const auto& result = (*copied)["limit"];
+    if (result.type != parsing::valuetypes::size or result.as_uint64() != 65536 or (*copied)["offset"].as_int64() != -12 or not (*copied)["force"].as_bool() or (*copied)["retries"].as_uint64() != 3) {
+      tf.show_failure(parser.m.name + ":copied", values);
+    }
+  }
+  tf.show_passed(parser.m.name);
+}
+
+
+void test_lexer_tokens() {
+  std::deque<std::string> values = {"--define=a=b", "-", "-5", "--", "--define"};
+
+  TestFormatter tf(24);
+
+  std::vector<std::string_view> views(values.begin(), values.end());
+  auto tokens = parsing::lex(views, false);
+  if (tokens.size() != 5 or tokens[0].flag() != "--define" or tokens[0].value() != "a=b"
+      or tokens[1].kind != parsing::tokenkinds::positional or tokens[2].kind != parsing::tokenkinds::positional
+      or tokens[3].kind != parsing::tokenkinds::separator or tokens[4].kind != parsing::tokenkinds::positional) {
+    tf.show_failure("lexer", values);
+  }
+  tf.show_passed("lexer");
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("lexer:parse");
+  parser.add_argument("--define");
+  parser.add_argument("rest").nargs("*");
+  parsing::Namespace args = parser.parse_args(values);
+  if (args["define"].as_string() != "a=b" or args["rest"].as_strings().size() != 3 or args["rest"].as_strings().back() != "--define") {
+    tf.show_failure(parser.m.name, values);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+
+void test_static_spec() {
+  const char* argv[] = {"prog", "-j", "8", "out", "a.txt", "b.txt", "--verbose"};
+  std::deque<std::string> expected(argv, argv + 7);
+
+  TestFormatter tf(24);
+
+  static constexpr auto cli = parsing::spec(
+    parsing::flag<int>("--jobs", "-j", 1),
+    parsing::flag<bool>("--verbose", "-v"),
+    parsing::positional<std::string_view>("dest"),
+    parsing::positional<std::string_view, parsing::nargstypes::plus>("sources")
+  );
+  static_assert(cli.find("-j") == 0 and cli.find("--verbose") == 1 and cli.find("--nope") == 4);
+
+  auto parsed = cli.parse(7, argv);
+  if (not parsed or parsed.get<0>() != 8 or not parsed.get<1>() or parsed.get<2>() != "out"
+      or parsed.get<3>().size() != 2 or parsed.get<3>()[1] != "b.txt") {
+    tf.show_failure("spec", expected);
+  }
+  auto bad = cli.parse(3, argv);
+  if (bad or bad.error != parsing::errors::missing_positional) {
+    tf.show_failure("spec:missing", expected);
+  }
+  tf.show_passed("spec");
+}
+
+
+void test_try_parse() {
+  std::deque<std::string> help = {"src", "--help"};
+  std::deque<std::string> unknown = {"src", "--nope"};
+  std::deque<std::string> typed = {"src", "--jobs", "many"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("try_parse");
+  parser.add_argument("source");
+  parser.add_argument("--jobs").type("int");
+  auto parsed = parser.try_parse_args(help);
+  if (parsed or parsed.outcome != parsing::outcomes::help) {
+    tf.show_failure(parser.m.name + ":help", help);
+  }
+  parsed = parser.try_parse_args(unknown);
+  if (parsed.outcome != parsing::outcomes::error or parsed.error.code != parsing::errors::unrecognized_optional or parsed.error.position != 1) {
+    tf.show_failure(parser.m.name + ":unknown", unknown);
+  }
+  parsed = parser.try_parse_args(typed);
+  if (parsed.error.code != parsing::errors::invalid_value or parsed.error.message() != "argument --jobs: invalid int64 value: many") {
+    tf.show_failure(parser.m.name + ":typed", typed);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_response_files() {
+  std::string lines = "/tmp/parsing-test-lines.rsp";
+  std::string words = "/tmp/parsing-test-words.rsp";
+  std::string loop = "/tmp/parsing-test-loop.rsp";
+  std::ofstream(lines) << "--jobs\r\n4\n\ntwo words\n";
+  std::ofstream(words) << "# comment\n--jobs 4 'two words' \"esc\\\"aped\" back\\ slash\n";
+  std::ofstream(loop) << "@" << loop << "\n";
+  std::deque<std::string> newline = {"src", "@" + lines, "last"};
+  std::deque<std::string> shell = {"src", "@" + words};
+  std::deque<std::string> missing = {"src", "@/nonexistent/parsing.rsp"};
+  std::deque<std::string> recursive = {"src", "@" + loop};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("response_files");
+  parser.m.fromfile_prefix_chars = "@";
+  parser.add_argument("source");
+  parser.add_argument("rest").nargs("*");
+  parser.add_argument("--jobs").type("int");
+  parsing::Namespace args;
+  {
+    // The namespace keeps the file mapped after the parse result is gone
+    auto parsed = parser.try_parse_args(newline);
+    args = std::move(parsed.values);
+  }
+  if (args["jobs"].as_int() != 4 or args["rest"].as_strings() != std::vector<std::string>{"two words", "last"}) {
+    tf.show_failure(parser.m.name + ":newline", newline);
+  }
+  parser.m.fromfile_mode = parsing::rspmodes::shell;
+  auto parsed = parser.try_parse_args(shell);
+  if (not parsed or parsed.values["jobs"].as_int() != 4 or parsed.values["rest"].as_strings() != std::vector<std::string>{"two words", "esc\"aped", "back slash"}) {
+    tf.show_failure(parser.m.name + ":shell", shell);
+  }
+  parsed = parser.try_parse_args(missing);
+  if (parsed.error.code != parsing::errors::unreadable_file or parsed.error.position != 1) {
+    tf.show_failure(parser.m.name + ":missing", missing);
+  }
+  parsed = parser.try_parse_args(recursive);
+  if (parsed.error.code != parsing::errors::recursive_file) {
+    tf.show_failure(parser.m.name + ":recursive", recursive);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_streamed_positionals() {
+  std::deque<std::string> argv = {"out", "a", "--jobs", "2", "b", "c"};
+  std::deque<std::string> piped = {"out", "-"};
+  std::deque<std::string> typed = {"out", "1", "x"};
+
+  TestFormatter tf(24);
+
+  std::vector<std::string> seen;
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("streamed");
+  parser.add_argument("target");
+  auto& paths = parser.add_argument("paths").nargs("+").stream([&seen](std::string_view value){ seen.emplace_back(value); }).stream_stdin(true);
+  parser.add_argument("--jobs").type("int");
+  auto args = parser.parse_args(argv);
+  if (seen != std::vector<std::string>{"a", "b", "c"} or not args[paths].empty() or args["target"].as_view() != "out") {
+    tf.show_failure(parser.m.name + ":argv", argv);
+  }
+
+  // The last record doesn't need a terminator, and empty ones are dropped
+  int fds[2];
+  int saved = dup(STDIN_FILENO);
+  if (pipe(fds) != 0 or write(fds[1], "first\0second\0\0third", 20) != 20) {
+    tf.show_failure(parser.m.name + ":pipe", piped);
+  }
+  close(fds[1]);
+  dup2(fds[0], STDIN_FILENO);
+  close(fds[0]);
+  seen.clear();
+  args = parser.parse_args(piped);
+  dup2(saved, STDIN_FILENO);
+  close(saved);
+  if (seen != std::vector<std::string>{"first", "second", "third"}) {
+    tf.show_failure(parser.m.name + ":stdin", piped);
+  }
+
+  // Records straddling 4-byte chunks still come out whole
+  seen.clear();
+  if (pipe(fds) != 0 or write(fds[1], "first\0second\0\0third", 20) != 20) {
+    tf.show_failure(parser.m.name + ":pipe", piped);
+  }
+  close(fds[1]);
+  parsing::RecordReader reader{fds[0], '\0', 4};
+  reader.each([&seen](std::string_view value){ seen.emplace_back(value); return true; });
+  close(fds[0]);
+  if (seen != std::vector<std::string>{"first", "second", "third"} or parsing::RecordReader{-1}.each([](std::string_view){ return true; })) {
+    tf.show_failure(parser.m.name + ":chunks", piped);
+  }
+
+  parser = parsing::ArgumentParser::create_parser("streamed:typed");
+  parser.add_argument("target");
+  parser.add_argument("counts").nargs("*").type("int").stream([&seen](std::string_view value){ seen.emplace_back(value); });
+  seen.clear();
+  auto parsed = parser.try_parse_args(typed);
+  if (parsed.error.code != parsing::errors::invalid_value or parsed.error.token != "x" or seen != std::vector<std::string>{"1"}) {
+    tf.show_failure(parser.m.name, typed);
+  }
+  tf.show_passed("streamed");
+}
+
+void test_parse_batch() {
+  std::deque<std::string> names = {"src-0", "--jobs", "0", "src-999"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("parse_batch");
+  parser.add_argument("source");
+  parser.add_argument("--jobs").type("int").default_value("1");
+  parser.compile();
+
+  // Every seventh line is broken, so errors have to stay in place too
+  std::vector<std::string> storage;
+  for (std::size_t ix = 0; ix < 1000; ++ix) {
+    storage.push_back("src-" + std::to_string(ix));
+    storage.push_back(ix % 7 == 0 ? "many" : std::to_string(ix));
+  }
+  std::vector<std::vector<std::string_view>> batch;
+  for (std::size_t ix = 0; ix < 1000; ++ix) {
+    batch.push_back({storage[ix * 2], "--jobs", storage[ix * 2 + 1]});
+  }
+  auto parsed = parser.parse_batch(batch, 4);
+  bool ordered = parsed.size() == batch.size();
+  for (std::size_t ix = 0; ordered and ix < parsed.size(); ++ix) {
+    if (ix % 7 == 0) {
+      ordered = parsed[ix].error.code == parsing::errors::invalid_value;
+    }
+    else {
+      ordered = parsed[ix] and parsed[ix].values["source"].as_view() == storage[ix * 2] and parsed[ix].values["jobs"].as_int() == int(ix);
+    }
+  }
+  if (not ordered or not parser.parse_batch({}).empty()) {
+    tf.show_failure(parser.m.name, names);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_parse_line() {
+  std::string line = "src 'two words' --name=\"$USER-${HOST}\" $EMPTY back\\ slash '$USER' $ ";
+  std::deque<std::string> words = {"src", "two words", "--name=me-box", "back slash", "$USER", "$"};
+  std::deque<std::string> unterminated = {"src \"open"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("parse_line");
+  parser.add_argument("source");
+  parser.add_argument("rest").nargs("*");
+  parser.add_argument("--name");
+  auto lookup = [](std::string_view name) -> std::string {
+    return name == "USER" ? "me" : name == "HOST" ? "box" : "";
+  };
+  auto args = parser.parse_line(line, lookup);
+  auto rest = args["rest"].as_views();
+  if (args["source"].as_view().data() != line.data() or rest.at(0).data() != line.data() + 5 or args["name"].as_view() != "me-box" or args["rest"].as_strings() != std::vector<std::string>{"two words", "back slash", "$USER", "$"}) {
+    tf.show_failure(parser.m.name + ":expand", words);
+  }
+  // Without a hook '$' is just a character
+  args = parser.parse_line("src $HOME");
+  if (args["rest"].as_view() != "$HOME") {
+    tf.show_failure(parser.m.name + ":literal", words);
+  }
+  auto parsed = parser.try_parse_line(unterminated.front());
+  if (parsed.error.code != parsing::errors::malformed_line) {
+    tf.show_failure(parser.m.name + ":unterminated", unterminated);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_subparsers() {
+  std::deque<std::string> run = {"-v", "run", "job", "--jobs", "3"};
+  std::deque<std::string> help = {"stop", "--help"};
+  std::deque<std::string> unknown = {"-v", "launch"};
+  std::deque<std::string> missing = {"-v"};
+  std::deque<std::string> failing = {"run", "job", "--jobs", "many"};
+
+  TestFormatter tf(24);
+
+  std::size_t built = 0;
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("subparsers");
+  parser.add_argument("-v").action(parsing::actions::store_true);
+  auto& commands = parser.add_subparsers();
+  commands.add_parser("run", [&built](parsing::ArgumentParser& sub){
+    ++built;
+    sub.add_argument("target");
+    sub.add_argument("--jobs").type("int");
+  }, "Run something.");
+  commands.add_parser("stop", [&built](parsing::ArgumentParser& sub){
+    ++built;
+    sub.add_argument("--force").action(parsing::actions::store_true);
+  });
+
+  auto args = parser.parse_args(run);
+  if (built != 1 or args.command != "run" or args["v"].as_view() != "true" or args["target"].as_view() != "job" or args.subcommand->operator[]("jobs").as_int() != 3) {
+    tf.show_failure(parser.m.name + ":run", run);
+  }
+  auto parsed = parser.try_parse_args(help);
+  if (parsed.outcome != parsing::outcomes::help or parsed.parser == nullptr or parsed.parser->m.name != "subparsers stop" or built != 2) {
+    tf.show_failure(parser.m.name + ":help", help);
+  }
+  parsed = parser.try_parse_args(unknown);
+  if (parsed.error.code != parsing::errors::unknown_command or parsed.error.position != 1 or built != 2) {
+    tf.show_failure(parser.m.name + ":unknown", unknown);
+  }
+  parsed = parser.try_parse_args(missing);
+  if (parsed.error.code != parsing::errors::missing_command or parsed.error.message() != "missing command, expected one of: run, stop") {
+    tf.show_failure(parser.m.name + ":missing", missing);
+  }
+  parsed = parser.try_parse_args(failing);
+  if (parsed.error.code != parsing::errors::invalid_value or parsed.error.position != -1 or parsed.parser->m.name != "subparsers run") {
+    tf.show_failure(parser.m.name + ":failing", failing);
+  }
+
+  // Literal names stay views, others are copied once and survive into copies; compiling sorts
+  // them for dispatch, and anything added later is still found
+  std::vector<std::string> names = {"build", "apply"};
+  for (auto& name : names) {
+    commands.add_parser(name, [](parsing::ArgumentParser&){}, "Synthetic " + name + ".");
+  }
+  names.assign({"clobbered", "clobbered"});
+  parsing::ArgumentParser copy = parser;
+  copy.compile();
+  copy.m.subparsers.front().add_parser("later", [](parsing::ArgumentParser&){});
+  using views = std::vector<std::string_view>;
+  const auto& registered = copy.m.subparsers.front();
+  if (registered.text->size() != 4 or registered.entries.at(2).help != "Synthetic build." or registered.order.size() != 4
+      or copy.parse_args(views{"apply"}).command != "apply" or copy.parse_args(views{"stop"}).command != "stop" or copy.parse_args(views{"later"}).command != "later") {
+    tf.show_failure(parser.m.name + ":registered", run);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_completion() {
+  std::deque<std::string> words = {"tool", "-v", "run", "--j"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("tool");
+  parser.add_argument({"--verbose", "-v"}).action(parsing::actions::store_true);
+  auto& commands = parser.add_subparsers();
+  commands.add_parser("run", [](parsing::ArgumentParser& sub){
+    sub.add_argument("--jobs");
+    sub.add_argument("--json").action(parsing::actions::store_true);
+  });
+  commands.add_parser("rename", [](parsing::ArgumentParser&){});
+  commands.add_parser("stop", [](parsing::ArgumentParser&){});
+  auto index = parser.completion_index();
+
+  using views = std::vector<std::string_view>;
+  if (parsing::complete(index, {"tool", "-v", "run", "--j"}, 3) != views{"--jobs", "--json"}
+      or parsing::complete(index, {"tool", "r"}, 1) != views{"run", "rename"}
+      or parsing::complete(index, {"tool", "--verb"}, 1) != views{"--verbose"}
+      or parsing::complete(index, {"tool", "stop"}, 2) != views{}
+      or parsing::complete(index, {"tool", "--", "r"}, 2) != views{}
+      or parsing::complete("not an index", {"tool", "r"}, 1) != views{}) {
+    tf.show_failure(parser.m.name + ":complete", words);
+  }
+
+  std::vector<std::string> storage = {"tool", "--_complete", "2", "tool", "run", "--js"};
+  std::vector<char*> argv;
+  for (auto& arg : storage) {
+    argv.push_back(arg.data());
+  }
+  std::ostringstream out;
+  if (not parsing::handle_completion(index, int(argv.size()), argv.data(), out) or out.str() != "--json\n" or parsing::handle_completion(index, 2, argv.data(), out)) {
+    tf.show_failure(parser.m.name + ":handle", words);
+  }
+  if (parsing::completion_script(parsing::shells::bash, "tool").find("complete -o default -F _tool_complete tool") == std::string::npos) {
+    tf.show_failure(parser.m.name + ":script", words);
+  }
+  tf.show_passed("completion");
+}
+
+void test_static_tables() {
+  std::deque<std::string> flags = {"--max-options"};
+
+  TestFormatter tf(24);
+
+  static_assert(parsing::name_of(parsing::actions::append_const) == "append_const");
+  static_assert(parsing::name_of(parsing::valuetypes::float64) == "double");
+  parsing::Action action({"--max-options"});
+  if (action.metavar_ != "MAX-OPTIONS" or parsing::to_upper("dest_\xc3\xa9").substr(0, 5) != "DEST_") {
+    tf.show_failure("static_tables", flags);
+  }
+  tf.show_passed("static_tables");
+}
+
+void test_abbreviations() {
+  std::deque<std::string> unique = {"--verb", "--out=x", "--col"};
+  std::deque<std::string> ambiguous = {"--ver"};
+  std::deque<std::string> exact = {"--out", "a", "--output", "b"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("abbreviations");
+  parser.add_argument("--verbose").action(parsing::actions::store_true);
+  parser.add_argument("--version").action(parsing::actions::version);
+  parser.add_argument("--output");
+  parser.add_argument("--out");
+  parser.add_argument({"--colour", "--color"}).action(parsing::actions::store_true);
+  auto args = parser.parse_args(unique);
+  if (args["verbose"].as_view() != "true" or args["out"].as_view() != "x" or args["colour"].as_view() != "true") {
+    tf.show_failure(parser.m.name + ":unique", unique);
+  }
+  auto parsed = parser.try_parse_args(ambiguous);
+  if (parsed.error.code != parsing::errors::ambiguous_option or parsed.error.message() != "ambiguous option: --ver could match --verbose, --version") {
+    tf.show_failure(parser.m.name + ":ambiguous", ambiguous);
+  }
+  args = parser.parse_args(exact);
+  if (args["out"].as_view() != "a" or args["output"].as_view() != "b") {
+    tf.show_failure(parser.m.name + ":exact", exact);
+  }
+  parser.m.allow_abbrev = false;
+  parsed = parser.try_parse_args(unique);
+  if (parsed.error.code != parsing::errors::unrecognized_optional) {
+    tf.show_failure(parser.m.name + ":disabled", unique);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_short_clusters() {
+  std::deque<std::string> counted = {"-vvv", "-v"};
+  std::deque<std::string> clustered = {"-xzf", "archive.tar", "-ofile", "-j8"};
+  std::deque<std::string> unknown = {"-xqz"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("clusters");
+  parser.add_argument({"-v", "--verbose"}).action(parsing::actions::count);
+  parser.add_argument("-x").action(parsing::actions::store_true);
+  parser.add_argument("-z").action(parsing::actions::store_true);
+  parser.add_argument("-f");
+  parser.add_argument("-o");
+  parser.add_argument("-j").type("int");
+  auto args = parser.parse_args(counted);
+  if (args["verbose"].as_int() != 4 or args["verbose"].as_view() != "4") {
+    tf.show_failure(parser.m.name + ":count", counted);
+  }
+  args = parser.parse_args(clustered);
+  if (args["x"].as_view() != "true" or args["z"].as_view() != "true" or args["f"].as_view() != "archive.tar" or args["o"].as_view() != "file" or args["j"].as_int() != 8 or args.count("verbose") != 0) {
+    tf.show_failure(parser.m.name + ":values", clustered);
+  }
+  auto parsed = parser.try_parse_args(unknown);
+  if (parsed.error.code != parsing::errors::unrecognized_optional or parsed.error.token != "-xqz") {
+    tf.show_failure(parser.m.name + ":unknown", unknown);
+  }
+  tf.show_passed(parser.m.name);
+
+  parser = parsing::ArgumentParser::create_parser("clusters:default");
+  parser.add_argument("-v").action(parsing::actions::count).default_value("2");
+  args = parser.parse_args(counted);
+  if (args["v"].as_int() != 6) {
+    tf.show_failure(parser.m.name, counted);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_env_fallback() {
+  std::deque<std::string> none = {};
+  std::deque<std::string> given = {"--jobs", "2"};
+
+  TestFormatter tf(24);
+
+  setenv("PARSING_TEST_JOBS", "8", 1);
+  setenv("PARSING_TEST_BAD", "many", 1);
+  unsetenv("PARSING_TEST_UNSET");
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("env");
+  parser.add_argument("--jobs").type("int").env("PARSING_TEST_JOBS").default_value("1");
+  parser.add_argument("--level").env("PARSING_TEST_UNSET").default_value("low");
+  parser.add_argument("--mode").env("PARSING_TEST_JOBS");
+  auto args = parser.parse_args(none);
+  if (args["jobs"].as_int() != 8 or args["level"].as_view() != "low" or args["mode"].as_view() != "8") {
+    tf.show_failure(parser.m.name + ":fallback", none);
+  }
+  args = parser.parse_args(given);
+  if (args["jobs"].as_int() != 2) {
+    tf.show_failure(parser.m.name + ":cli", given);
+  }
+  tf.show_passed(parser.m.name);
+
+  parser = parsing::ArgumentParser::create_parser("env:typed");
+  parser.add_argument("--jobs").type("int").env("PARSING_TEST_BAD");
+  auto parsed = parser.try_parse_args(none);
+  if (parsed.error.code != parsing::errors::invalid_value or parsed.error.token != "many") {
+    tf.show_failure(parser.m.name, none);
+  }
+  tf.show_passed(parser.m.name);
+
+  // Flags read a boolean (count a number), and values are split and held to nargs like a
+  // defaults file's
+  setenv("PARSING_TEST_QUIET", "1", 1);
+  setenv("PARSING_TEST_COLOR", "off", 1);
+  setenv("PARSING_TEST_VERBOSE", "3", 1);
+  setenv("PARSING_TEST_SIZE", " 3  4 ", 1);
+  setenv("PARSING_TEST_FILES", "a.c b.c c.c", 1);
+  parser = parsing::ArgumentParser::create_parser("env:shaped");
+  parser.add_argument("--quiet").action(parsing::actions::store_true).env("PARSING_TEST_QUIET");
+  parser.add_argument("--no-color").action(parsing::actions::store_false).dest("color").env("PARSING_TEST_COLOR");
+  parser.add_argument("-v").action(parsing::actions::count).env("PARSING_TEST_VERBOSE");
+  parser.add_argument("--size").nargs(2).type("int").env("PARSING_TEST_SIZE");
+  parser.add_argument("--files").nargs("+").env("PARSING_TEST_FILES");
+  args = parser.parse_args(none);
+  if (not args["quiet"].as_bool() or not args["color"].as_bool() or args["v"].as_int() != 3 or args["size"].as_ints() != std::vector<int>{3, 4} or args["files"].as_strings() != std::vector<std::string>{"a.c", "b.c", "c.c"}) {
+    tf.show_failure(parser.m.name, none);
+  }
+  setenv("PARSING_TEST_QUIET", "maybe", 1);
+  parsed = parser.try_parse_args(none);
+  if (parsed.error.code != parsing::errors::invalid_value or parsed.error.message() != "argument --quiet: invalid bool value: maybe") {
+    tf.show_failure(parser.m.name + ":flag", none);
+  }
+  setenv("PARSING_TEST_QUIET", "0", 1);
+  setenv("PARSING_TEST_SIZE", "3 4 5", 1);
+  parsed = parser.try_parse_args(none);
+  if (parsed.error.code != parsing::errors::unexpected_value or parsed.error.token != "5") {
+    tf.show_failure(parser.m.name + ":many", none);
+  }
+  setenv("PARSING_TEST_SIZE", "3", 1);
+  parsed = parser.try_parse_args(none);
+  if (parsed.error.code != parsing::errors::missing_value or parsed.error.count != 1 or parsed.error.token != "PARSING_TEST_SIZE") {
+    tf.show_failure(parser.m.name + ":few", none);
+  }
+  for (const auto* name : {"PARSING_TEST_QUIET", "PARSING_TEST_COLOR", "PARSING_TEST_VERBOSE", "PARSING_TEST_SIZE", "PARSING_TEST_FILES"}) {
+    unsetenv(name);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_defaults_files() {
+  std::string ini = "/tmp/parsing-test-defaults.ini";
+  std::string json = "/tmp/parsing-test-defaults.json";
+  std::string broken = "/tmp/parsing-test-broken.ini";
+  std::string unknown = "/tmp/parsing-test-unknown.ini";
+  std::string invalid = "/tmp/parsing-test-invalid.json";
+  std::string unknown_json = "/tmp/parsing-test-unknown.json";
+  std::string broken_json = "/tmp/parsing-test-broken.json";
+  std::ofstream(ini) << "# generated\n[build]\njobs = 4\nname = \"two words\"\r\nsources = a.c b.c\nlevel = mid\n";
+  std::ofstream(json) << "{\"level\": \"h\\u00efgh\", \"sources\": [\"x.c\"], \"name\": null}\n";
+  std::ofstream(broken) << "jobs = 1\nno separator here\n";
+  std::ofstream(unknown) << "\n\nthreads = 2\n";
+  std::ofstream(invalid) << "{\"jobs\": \"lots\"}";
+  std::ofstream(unknown_json) << "{\n  \"jobs\": 2,\n\n  \"thr\\u0065ads\": 2\n}\n";
+  std::ofstream(broken_json) << "{\n  \"jobs\": 2,\n  \"name\" \"x\"\n}\n";
+  std::deque<std::string> none = {};
+  std::deque<std::string> given = {"--jobs", "2"};
+
+  TestFormatter tf(24);
+
+  setenv("PARSING_TEST_LEVEL", "env", 1);
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("defaults_files");
+  parser.add_argument("--jobs").type("int").default_value("1");
+  parser.add_argument("--name").default_value("builtin");
+  parser.add_argument("--sources").nargs("*");
+  parser.add_argument("--level").env("PARSING_TEST_LEVEL");
+  parser.add_argument("--other").default_value("builtin");
+  parser.load_defaults(ini);
+  auto args = parser.parse_args(none);
+  if (args["jobs"].as_int() != 4 or args["name"].as_view() != "two words" or args["sources"].as_strings() != std::vector<std::string>{"a.c", "b.c"} or args["level"].as_view() != "env" or args["other"].as_view() != "builtin") {
+    tf.show_failure(parser.m.name + ":ini", none);
+  }
+  args = parser.parse_args(given);
+  if (args["jobs"].as_int() != 2) {
+    tf.show_failure(parser.m.name + ":cli", given);
+  }
+  unsetenv("PARSING_TEST_LEVEL");
+  parser.load_defaults(json);
+  args = parser.parse_args(none);
+  if (args["level"].as_view() != "h\u00efgh" or args["sources"].as_strings() != std::vector<std::string>{"x.c"} or args["name"].as_view() != "two words" or args["jobs"].as_int() != 4) {
+    tf.show_failure(parser.m.name + ":json", none);
+  }
+  tf.show_passed(parser.m.name);
+
+  auto loaded = parser.try_load_defaults(broken);
+  if (loaded.error.code != parsing::errors::malformed_config or loaded.error.count != 2) {
+    tf.show_failure(parser.m.name + ":malformed", none);
+  }
+  loaded = parser.try_load_defaults(unknown);
+  if (loaded.error.code != parsing::errors::unknown_key or loaded.error.message() != "unknown key in defaults file: threads (line 3)") {
+    tf.show_failure(parser.m.name + ":unknown", none);
+  }
+  // JSON lines are counted as the file is read, escaped keys included
+  loaded = parser.try_load_defaults(unknown_json);
+  if (loaded.error.code != parsing::errors::unknown_key or loaded.error.message() != "unknown key in defaults file: threads (line 4)") {
+    tf.show_failure(parser.m.name + ":unknown_json", none);
+  }
+  loaded = parser.try_load_defaults(broken_json);
+  if (loaded.error.code != parsing::errors::malformed_config or loaded.error.count != 3) {
+    tf.show_failure(parser.m.name + ":malformed_json", none);
+  }
+  loaded = parser.try_load_defaults(invalid);
+  if (loaded.error.code != parsing::errors::invalid_value or loaded.error.token != "lots") {
+    tf.show_failure(parser.m.name + ":invalid", none);
+  }
+  loaded = parser.try_load_defaults("/nonexistent/parsing.ini");
+  if (loaded.error.code != parsing::errors::unreadable_config or parser.m.defaults_files.size() != 2) {
+    tf.show_failure(parser.m.name + ":unreadable", none);
+  }
+  tf.show_passed(parser.m.name + ":errors");
+}
+
+void test_parser_images() {
+  std::string path = "/tmp/parsing-test.image";
+  std::string truncated = "/tmp/parsing-test-truncated.image";
+  constexpr auto fingerprint = parsing::fnv1a("test_parser_images v1");
+  std::deque<std::string> line = {"in.txt", "-vv", "--jobs", "3", "--out=o.txt", "--verb", "a", "b"};
+  std::deque<std::string> changed = {"in.txt", "--extra", "-j", "5"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("images");
+  parser.m.version = "1.2.3";
+  parser.m.description = "Saved and loaded.";
+  parser.add_argument("source").help("Where to read from.");
+  parser.add_argument("rest").nargs("*");
+  parser.add_argument({"-v", "--verbose"}).action(parsing::actions::count);
+  parser.add_argument({"-j", "--jobs"}).type("int").default_value("1").env("PARSING_TEST_IMAGE_JOBS");
+  parser.add_argument("--output").dest("out");
+  parser.add_argument("--mode").const_value("fast").action(parsing::actions::store_const);
+  if (not parser.save_image(path, fingerprint)) {
+    tf.show_failure(parser.m.name + ":save", line);
+  }
+  auto expected = parser.parse_args(line);
+
+  auto loaded = parsing::ArgumentParser::load_image(path, fingerprint);
+  if (not loaded) {
+    tf.show_failure(parser.m.name + ":load", line);
+    return;
+  }
+  auto& copy = *loaded;
+  copy.compile();
+  auto args = copy.parse_args(line);
+  if (args["source"].as_view() != "in.txt" or args["verbose"].as_int() != 3 or args["jobs"].as_int() != 3 or args["out"].as_view() != "o.txt" or args["rest"].as_strings() != std::vector<std::string>{"a", "b"} or args["mode"].as_view() != "") {
+    tf.show_failure(parser.m.name + ":parse", line);
+  }
+  const auto& original = parser.m.core->groups.at(1).arguments.at(2);
+  const auto& restored = copy.m.core->groups.at(1).arguments.at(2);
+  if (copy.m.version != "1.2.3" or copy.m.description != parser.m.description or restored.flags_ != original.flags_ or restored.flags_string_ != original.flags_string_ or restored.metavar_ != original.metavar_ or restored.env_ != original.env_ or restored.index_ != original.index_ or copy.m.core->size() != parser.m.core->size()) {
+    tf.show_failure(parser.m.name + ":fields", line);
+  }
+  if (not copy.flag_table or copy.flag_table->find("--jobs") != &restored or copy.flag_table->shorts['j'] != &restored) {
+    tf.show_failure(parser.m.name + ":tables", line);
+  }
+  tf.show_passed(parser.m.name);
+
+  // Anything that doesn't match exactly is turned away
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::ofstream(truncated, std::ios::binary) << bytes.substr(0, bytes.size() - 8);
+  if (parsing::ArgumentParser::load_image(path, fingerprint + 1) or parsing::ArgumentParser::load_image(truncated, fingerprint) or parsing::ArgumentParser::load_image("/nonexistent/parsing.image", fingerprint)) {
+    tf.show_failure(parser.m.name + ":rejected", line);
+  }
+
+  // Changing a loaded parser drops the image and builds its tables as usual
+  copy.add_argument("--extra").action(parsing::actions::store_true);
+  copy.compile();
+  args = copy.parse_args(changed);
+  if (copy.m.image or args["extra"].as_view() != "true" or args["jobs"].as_int() != 5 or copy.m.core->groups.at(1).flags.count("--jobs") != 1) {
+    tf.show_failure(parser.m.name + ":changed", changed);
+  }
+  tf.show_passed(parser.m.name + ":rejected");
+}
+
+void test_parse_stats() {
+  std::deque<std::string> line = {"in.txt", "-vv", "--jobs", "3", "a", "b"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("stats");
+  parser.add_argument("source");
+  parser.add_argument("rest").nargs("*");
+  parser.add_argument("-v").action(parsing::actions::count);
+  parser.add_argument("--jobs").type("int");
+  auto parsed = parser.try_parse_args(line);
+#if PARSING_STATS
+  const auto& stats = parsed.stats;
+  auto lex = stats.phase_ns[static_cast<std::size_t>(parsing::ParseStats::phases::lex)];
+  auto trace = stats.chrome_trace();
+  if (stats.tokens != line.size() or stats.lookups != 4 or stats.allocations == 0 or stats.bytes == 0 or stats.span_count != 8 or lex == 0 or stats.total_ns() < lex) {
+    tf.show_failure(parser.m.name, line);
+  }
+  if (trace.find("\"name\": \"parse\"") == std::string::npos or trace.find("\"name\": \"positionals\"") == std::string::npos or trace.find("\"tokens\": 6") == std::string::npos) {
+    tf.show_failure(parser.m.name + ":trace", line);
+  }
+#else
+  if (not parsed or parsing::stats_enabled) {
+    tf.show_failure(parser.m.name + ":disabled", line);
+  }
+#endif
+  tf.show_passed(parser.m.name);
+}
+
+// Counts what passes through it on the way to the default resource
+struct TallyResource : std::pmr::memory_resource {
+  std::size_t allocations = 0;
+private:
+  auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override {
+    ++allocations;
+    return std::pmr::get_default_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override {
+    std::pmr::get_default_resource()->deallocate(pointer, bytes, alignment);
+  }
+  auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override {
+    return this == &other;
+  }
+};
+
+void test_pmr_allocation() {
+  std::deque<std::string> line = {"in.txt", "--output", "somewhere/well/past/the/small/string/buffer.txt", "-vv", "run", "--jobs", "4"};
+
+  TestFormatter tf(24);
+
+  // With nothing upstream, anything that escapes the buffer throws instead of quietly using the heap
+  std::vector<std::byte> buffer(1 << 16);
+  std::pmr::monotonic_buffer_resource pool(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("pmr_allocation", &pool);
+  parser.add_argument("source").help("Where the input comes from, described at a length no small string buffer holds.");
+  parser.add_argument({"-o", "--output"}).metavar("SOME_LONG_METAVARIABLE_NAME");
+  parser.add_argument({"-v", "--verbose"}).action(parsing::actions::count);
+  parser.add_subparsers().add_parser("run", [](parsing::ArgumentParser& command){
+    command.add_argument("--jobs").type("int");
+  });
+  const auto& output = parser.m.core->groups.at(1).arguments.at(1);
+  if (parser.resource() != &pool or output.help_.get_allocator().resource() != &pool or output.flags_.at(1).get_allocator().resource() != &pool or parser.m.core->groups.at(0).name.get_allocator().resource() != &pool) {
+    tf.show_failure(parser.m.name + ":parser", line);
+  }
+  parser.compile();
+
+  TallyResource tally;
+  std::vector<std::string_view> args(line.begin(), line.end());
+  auto parsed = parser.try_parse_args(args, &tally);
+  if (not parsed or tally.allocations == 0 or parsed.values["output"].as_view() != line[2] or parsed.values["verbose"].as_int() != 2 or parsed.values.subcommand->operator[]("jobs").as_int() != 4) {
+    tf.show_failure(parser.m.name + ":parse", line);
+  }
+  // The subcommand's parser came from the same resource
+  const auto* child = std::static_pointer_cast<parsing::ArgumentParser>(parsed.values.backing.back()).get();
+  if (child->resource() != &tally) {
+    tf.show_failure(parser.m.name + ":subcommand", line);
+  }
+
+  // Copies share the parser's core, and so its pool, including for what they add themselves
+  parsing::ArgumentParser copy = parser;
+  copy.add_argument("--extra");
+  auto copied = copy.parse_args(line);
+  if (copy.resource() != &pool or copy.m.core->groups.at(1).arguments.at(0).help_.get_allocator().resource() != &pool or copied["source"].as_view() != "in.txt" or copy.m.core->find_flag("--output") != &output) {
+    tf.show_failure(parser.m.name + ":copy", line);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_line_resources() {
+  std::string line = "in.txt --output some\\ path/well/past/the/small/string/buffer.txt";
+  std::deque<std::string> words = {"in.txt", "--output", "some path/well/past/the/small/string/buffer.txt"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("line_resources");
+  parser.add_argument("source");
+  parser.add_argument({"-o", "--output"});
+  parser.compile();
+
+  // The same words as a plain parse, plus the rebuilt word, its list and the list's control block
+  TallyResource plain;
+  std::vector<std::string_view> args(words.begin(), words.end());
+  auto baseline = parser.try_parse_args(args, &plain);
+  TallyResource tally;
+  auto parsed = parser.try_parse_line(line, {}, &tally);
+  using Words = std::pmr::forward_list<std::pmr::string>;
+  const auto* owned = parsed.values.backing.empty() ? nullptr : static_cast<const Words*>(parsed.values.backing.back().get());
+  if (not baseline or not parsed or parsed.values["output"].as_view() != words[2] or owned == nullptr or owned->get_allocator().resource() != &tally or owned->front().get_allocator().resource() != &tally or tally.allocations < plain.allocations + 3) {
+    tf.show_failure(parser.m.name + ":line", words);
+  }
+
+  // Each item of a batch goes to the resource picked for it
+  std::vector<std::vector<std::string_view>> batch(8, args);
+  std::vector<TallyResource> tallies(batch.size());
+  auto results = parser.parse_batch(batch, 4, [&tallies](std::size_t ix){ return &tallies[ix]; });
+  bool spread = results.size() == batch.size();
+  for (std::size_t ix = 0; spread and ix < results.size(); ++ix) {
+    spread = results[ix] and tallies[ix].allocations == plain.allocations and results[ix].values["source"].as_view() == "in.txt";
+  }
+  if (not spread) {
+    tf.show_failure(parser.m.name + ":batch", words);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_shared_cores() {
+  std::deque<std::string> line = {"in.txt", "--jobs", "4", "-vv"};
+  std::deque<std::string> tenant_line = {"in.txt", "--tenant-id", "t1", "--jobs=2"};
+  std::deque<std::string> later = {"in.txt", "--later"};
+  std::deque<std::string> child_line = {"in.txt", "out.txt", "--quiet", "-j", "3"};
+  std::deque<std::string> help = {"in.txt", "out.txt", "--help"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser base = parsing::ArgumentParser::create_parser("shared_cores");
+  base.add_argument("source");
+  auto& jobs = base.add_argument({"-j", "--jobs"}).type("int").default_value("1");
+  base.add_argument("-v").action(parsing::actions::count);
+  base.compile();
+
+  // A copy shares everything until it adds something, and then only adds a layer
+  parsing::ArgumentParser tenant = base;
+  if (tenant.m.core != base.m.core or tenant.flag_table != base.flag_table or tenant.parse_args(line)[jobs].as_int() != 4) {
+    tf.show_failure(base.m.name + ":copy", line);
+  }
+  tenant.add_argument("--tenant-id");
+  auto args = tenant.parse_args(tenant_line);
+  if (tenant.m.core == base.m.core or tenant.m.core->parents.size() != 1 or tenant.m.core->parents.front() != base.m.core or args["tenant-id"].as_view() != "t1" or args[jobs].as_int() != 2 or base.m.core->find_flag("--tenant-id") != nullptr) {
+    tf.show_failure(base.m.name + ":layer", tenant_line);
+  }
+
+  // The original can still grow, without the copy seeing it
+  base.add_argument("--later").action(parsing::actions::store_true);
+  std::vector<std::string_view> later_args(later.begin(), later.end());
+  if (not base.try_parse_args(later_args) or tenant.try_parse_args(later_args).error.code != parsing::errors::unrecognized_optional) {
+    tf.show_failure(base.m.name + ":diverged", later);
+  }
+  tf.show_passed(base.m.name);
+
+  // Parents: their arguments come first, positionals included, and their help serves for the child's
+  parsing::ArgumentParser common = parsing::ArgumentParser::create_parser("common");
+  common.add_help(false);
+  common.add_argument({"-q", "--quiet"}).action(parsing::actions::store_true);
+  parsing::ArgumentParser child = parsing::ArgumentParser::create_parser("parents", {tenant, common});
+  child.add_argument("target");
+  args = child.parse_args(child_line);
+  if (args["source"].as_view() != "in.txt" or args["target"].as_view() != "out.txt" or args["quiet"].as_view() != "true" or args[jobs].as_int() != 3 or child.m.core->layers.size() != 4) {
+    tf.show_failure(child.m.name, child_line);
+  }
+  std::ostringstream sink;
+  auto* previous = std::cout.rdbuf(sink.rdbuf());
+  child.show_help();
+  std::cout.rdbuf(previous);
+  auto text = sink.str();
+  if (text.find("Options") != text.rfind("Options") or text.find("--quiet") == std::string::npos or text.find("--tenant-id") == std::string::npos or text.find("-h/--help") == std::string::npos) {
+    tf.show_failure(child.m.name + ":help", child_line);
+  }
+
+  // Dropping help that a parent brought copies the layers into one core for this parser alone
+  std::vector<std::string_view> help_args(help.begin(), help.end());
+  child.add_help(false);
+  auto unhelped = child.try_parse_args(help_args);
+  if (unhelped.outcome != parsing::outcomes::error or tenant.try_parse_args(help_args).outcome != parsing::outcomes::help or child.m.core->layers.size() != 1 or child.parse_args(child_line)["jobs"].as_int() != 3) {
+    tf.show_failure(child.m.name + ":no_help", help);
+  }
+  tf.show_passed(child.m.name);
+}
+
+void test_positional_layout() {
+  std::deque<std::string> few = {"a", "b", "c"};
+  std::deque<std::string> some = {"a", "b", "-v", "c", "d"};
+  std::deque<std::string> many = {"a", "b", "c", "--", "-d", "e", "f"};
+  std::deque<std::string> short_line = {"a", "-v"};
+  std::deque<std::string> extra = {"a", "b", "c", "d", "e"};
+
+  TestFormatter tf(24);
+
+  // The layout is worked out once: where each positional's minimum starts, and the total
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("positional_layout");
+  parser.add_argument("first");
+  parser.add_argument("maybe").nargs("?");
+  parser.add_argument("rest").nargs("*");
+  parser.add_argument("pair").nargs(2);
+  parser.add_argument("-v").action(parsing::actions::store_true);
+  parser.compile();
+  const auto& positionals = parser.dest_table->positionals;
+  if (positionals.size() != 4 or parser.dest_table->positional_min != 3 or positionals[3].before != 1 or positionals[2].max != parsing::DestTable::npos or positionals[1].nargs != parsing::nargstypes::optional) {
+    tf.show_failure(parser.m.name + ":layout", few);
+  }
+
+  // Earlier variable positionals only take what the later ones can spare
+  auto args = parser.parse_args(few);
+  if (args["first"].as_view() != "a" or args.count("maybe") != 0 or args.count("rest") != 0 or args["pair"].as_strings() != std::vector<std::string>{"b", "c"}) {
+    tf.show_failure(parser.m.name + ":few", few);
+  }
+  // Positionals between optionals are picked up in order, as argparse's intermixed parse does
+  args = parser.parse_intermixed_args(std::vector<std::string_view>(some.begin(), some.end()));
+  if (args["maybe"].as_view() != "b" or args.count("rest") != 0 or args["pair"].as_strings() != std::vector<std::string>{"c", "d"} or args["v"].as_view() != "true") {
+    tf.show_failure(parser.m.name + ":some", some);
+  }
+  args = parser.parse_args(many);
+  if (args["maybe"].as_view() != "b" or args["rest"].as_strings() != std::vector<std::string>{"c", "-d"} or args["pair"].as_strings() != std::vector<std::string>{"e", "f"}) {
+    tf.show_failure(parser.m.name + ":many", many);
+  }
+
+  // Too few names the first positional left short; too many report every spare token
+  auto parsed = parser.try_parse_args(short_line);
+  if (parsed.error.code != parsing::errors::missing_positional or parsed.error.action != positionals[3].action) {
+    tf.show_failure(parser.m.name + ":missing", short_line);
+  }
+  parsing::ArgumentParser fixed = parsing::ArgumentParser::create_parser("positional_layout");
+  fixed.add_argument("first");
+  fixed.add_argument("second");
+  parsed = fixed.try_parse_args(extra);
+  if (parsed.error.code != parsing::errors::unrecognized_positional or parsed.error.position != 2 or parsed.error.extra != std::vector<std::string_view>{"c", "d", "e"}) {
+    tf.show_failure(parser.m.name + ":extra", extra);
+  }
+  tf.show_passed(parser.m.name);
+}
+
+void test_append_occurrences() {
+  std::deque<std::string> line = {"--stage", "a", "b", "--tag", "x", "src", "--stage", "c", "--tag=y", "--pair", "1", "2", "--pair", "3", "4"};
+  std::deque<std::string> none = {"src"};
+  std::deque<std::string> short_pair = {"src", "--pair", "1", "--pair", "2", "3"};
+
+  TestFormatter tf(24);
+
+  parsing::ArgumentParser parser = parsing::ArgumentParser::create_parser("append");
+  parser.add_argument("source");
+  auto& stage = parser.add_argument("--stage").action(parsing::actions::append).nargs("+");
+  parser.add_argument("--tag").action(parsing::actions::append).default_value("none");
+  auto& pair = parser.add_argument("--pair").action(parsing::actions::append).nargs(2).type("int");
+  parser.compile();
+
+  // Every use keeps its own values, over one flat array
+  auto args = parser.parse_args(line);
+  const auto& stages = args[stage];
+  if (stages.occurrence_count() != 2 or stages.values.size() != 3 or stages.occurrence(0).size() != 2 or stages.occurrence(1)[0] != "c" or stages.occurrence(1).offset != 2) {
+    tf.show_failure(parser.m.name + ":stage", line);
+  }
+  std::vector<std::size_t> sizes;
+  for (auto occurrence : stages.occurrences()) {
+    sizes.push_back(occurrence.size());
+  }
+  if (sizes != std::vector<std::size_t>{2, 1} or args["tag"].as_strings() != std::vector<std::string>{"x", "y"} or args["tag"].occurrence_count() != 2) {
+    tf.show_failure(parser.m.name + ":iterate", line);
+  }
+  const auto& pairs = args[pair];
+  auto second = pairs.occurrence(1);
+  if (pair.action_ != parsing::actions::append or pairs.occurrence_count() != 2 or second.size() != 2 or pairs.typed[second.offset].i != 3 or pairs.typed[second.offset + 1].i != 4) {
+    tf.show_failure(parser.m.name + ":typed", line);
+  }
+
+  // A default counts as one occurrence, and nothing given as none
+  args = parser.parse_args(none);
+  if (args["tag"].occurrence_count() != 1 or args["tag"].occurrence(0)[0] != "none" or args[stage].occurrence_count() != 0 or args[stage].occurrences().begin() != args[stage].occurrences().end()) {
+    tf.show_failure(parser.m.name + ":none", none);
+  }
+
+  // Each use needs its own nargs, however many values came before it
+  auto parsed = parser.try_parse_args(short_pair);
+  if (parsed.error.code != parsing::errors::ambiguous_value or parsed.error.token != "--pair") {
+    tf.show_failure(parser.m.name + ":short", short_pair);
+  }
+  tf.show_passed(parser.m.name);
+}